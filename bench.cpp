@@ -0,0 +1,352 @@
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <thread>
+#include <vector>
+#include "cfg_template.hpp"
+#include "cfg_overlay.hpp"
+#include "cfg_export.hpp"
+
+/*
+   Microbenchmarks for the config read/write hot paths.
+
+   Results go to stdout, or to the file named by the first argument, as CSV
+   with one row per case:
+
+       benchmark,case,threads,iterations,ns_per_op
+*/
+
+/// Generated parameter names "P0000".."P9999", in static storage so the
+/// registry entries can refer to them
+template <std::size_t N>
+struct BenchKeys {
+    char names[N][6];
+
+    constexpr BenchKeys() : names{}
+    {
+        for (std::size_t i = 0; i < N; ++i) {
+            names[i][0] = 'P';
+            names[i][1] = static_cast<char>('0' + i / 1000 % 10);
+            names[i][2] = static_cast<char>('0' + i / 100 % 10);
+            names[i][3] = static_cast<char>('0' + i / 10 % 10);
+            names[i][4] = static_cast<char>('0' + i % 10);
+        }
+    }
+
+    constexpr std::string_view operator[](std::size_t i) const { return std::string_view(names[i], 5); }
+};
+
+template <std::size_t N>
+constexpr BenchKeys<N> kBenchKeys{};
+
+/// Registry table of N parms cycling through each kind of config value:
+/// read-only int, updatable int64, bool, string, updatable bool and
+/// updatable string
+template <typename TConfigEnum, std::size_t N>
+constexpr std::array<ParmDef<TConfigEnum>, N> makeBenchParms()
+{
+    std::array<ParmDef<TConfigEnum>, N> parms{};
+    for (std::size_t i = 0; i < N; ++i) {
+        auto parm = static_cast<TConfigEnum>(i);
+        switch (i % 6) {
+        case 0: parms[i] = intParm<int32_t>(parm, kBenchKeys<N>[i], 1000, "Read-only int"); break;
+        case 1: parms[i] = updatableIntParm<int64_t>(parm, kBenchKeys<N>[i], 0, "Updatable int"); break;
+        case 2: parms[i] = boolParm(parm, kBenchKeys<N>[i], true, "Bool"); break;
+        case 3: parms[i] = strParm(parm, kBenchKeys<N>[i], "512", "String"); break;
+        case 4: parms[i] = updatableBoolParm(parm, kBenchKeys<N>[i], true, "Updatable bool"); break;
+        case 5: parms[i] = updatableStrParm(parm, kBenchKeys<N>[i], "512", "Updatable string"); break;
+        }
+    }
+    return parms;
+}
+
+template <typename TConfigEnum, std::size_t N>
+struct BenchRegistry {
+    static constexpr const BenchKeys<N>& kKeys = kBenchKeys<N>;
+    static constexpr std::array<ParmDef<TConfigEnum>, N> parms = makeBenchParms<TConfigEnum, N>();
+};
+
+enum class Bench10Parm : int16_t { COUNT = 10 };
+enum class Bench100Parm : int16_t { COUNT = 100 };
+enum class Bench1000Parm : int16_t { COUNT = 1000 };
+
+template <> struct ConfigRegistry<Bench10Parm> : BenchRegistry<Bench10Parm, 10> {};
+template <> struct ConfigRegistry<Bench100Parm> : BenchRegistry<Bench100Parm, 100> {};
+template <> struct ConfigRegistry<Bench1000Parm> : BenchRegistry<Bench1000Parm, 1000> {};
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+/// Keep the compiler from optimizing away a benchmarked value
+template <typename T>
+inline void sink(const T& val)
+{
+    asm volatile("" : : "g"(&val) : "memory");
+}
+
+FILE* gOut = stdout;
+
+void report(const char* bench, const std::string& name, unsigned threads, uint64_t iters, Clock::duration elapsed)
+{
+    double ns = std::chrono::duration<double, std::nano>(elapsed).count();
+    std::fprintf(gOut, "%s,%s,%u,%llu,%.3f\n", bench, name.c_str(), threads,
+                 static_cast<unsigned long long>(iters), ns / static_cast<double>(iters));
+}
+
+constexpr uint64_t kReadIters = 10000000;
+
+/// Time as_<T>() on one parm
+template <typename T, typename TConfigEnum>
+void benchAs(const ConfigTemplate<TConfigEnum>& cfg, TConfigEnum parm, const char* cvName, const char* typeName)
+{
+    auto start = Clock::now();
+    for (uint64_t i = 0; i < kReadIters; ++i) {
+        T val = cfg.template as_<T>(parm);
+        sink(val);
+    }
+    report("as", std::string(cvName) + "/" + typeName, 1, kReadIters, Clock::now() - start);
+}
+
+/// Time as_<T>() for each kind of config value and each result type it supports
+void benchReads()
+{
+    ConfigTemplate<Bench10Parm> cfg(std::map<std::string, std::string>{});
+    const auto roInt = static_cast<Bench10Parm>(0);
+    const auto updInt = static_cast<Bench10Parm>(1);
+    const auto boolVal = static_cast<Bench10Parm>(2);
+    const auto strVal = static_cast<Bench10Parm>(3);
+    const auto updBool = static_cast<Bench10Parm>(4);
+    const auto updStr = static_cast<Bench10Parm>(5);
+
+    benchAs<int32_t>(cfg, roInt, "IntReadOnlyCV", "int32");
+    benchAs<int64_t>(cfg, roInt, "IntReadOnlyCV", "int64");
+    benchAs<bool>(cfg, roInt, "IntReadOnlyCV", "bool");
+    benchAs<std::string>(cfg, roInt, "IntReadOnlyCV", "string");
+    benchAs<int32_t>(cfg, updInt, "IntUpdatableCV", "int32");
+    benchAs<int64_t>(cfg, updInt, "IntUpdatableCV", "int64");
+    benchAs<bool>(cfg, updInt, "IntUpdatableCV", "bool");
+    benchAs<std::string>(cfg, updInt, "IntUpdatableCV", "string");
+    benchAs<int32_t>(cfg, boolVal, "BoolReadOnlyCV", "int32");
+    benchAs<bool>(cfg, boolVal, "BoolReadOnlyCV", "bool");
+    benchAs<std::string>(cfg, boolVal, "BoolReadOnlyCV", "string");
+    benchAs<int32_t>(cfg, strVal, "StrReadOnlyCV", "int32");
+    benchAs<int64_t>(cfg, strVal, "StrReadOnlyCV", "int64");
+    benchAs<bool>(cfg, strVal, "StrReadOnlyCV", "bool");
+    benchAs<std::string>(cfg, strVal, "StrReadOnlyCV", "string");
+    benchAs<int32_t>(cfg, updBool, "BoolUpdatableCV", "int32");
+    benchAs<bool>(cfg, updBool, "BoolUpdatableCV", "bool");
+    benchAs<std::string>(cfg, updBool, "BoolUpdatableCV", "string");
+    benchAs<int32_t>(cfg, updStr, "StrUpdatableCV", "int32");
+    benchAs<int64_t>(cfg, updStr, "StrUpdatableCV", "int64");
+    benchAs<bool>(cfg, updStr, "StrUpdatableCV", "bool");
+    benchAs<std::string>(cfg, updStr, "StrUpdatableCV", "string");
+
+    CVStrBuf scratch;
+    auto start = Clock::now();
+    for (uint64_t i = 0; i < kReadIters; ++i) {
+        sink(cfg.asStrView(updInt, scratch));
+    }
+    report("asStrView", "IntUpdatableCV", 1, kReadIters, Clock::now() - start);
+
+    start = Clock::now();
+    for (uint64_t i = 0; i < kReadIters; ++i) {
+        sink(cfg.asStrView(strVal, scratch));
+    }
+    report("asStrView", "StrReadOnlyCV", 1, kReadIters, Clock::now() - start);
+
+    start = Clock::now();
+    for (uint64_t i = 0; i < kReadIters; ++i) {
+        sink(cfg.asStrView(updStr, scratch));
+    }
+    report("asStrView", "StrUpdatableCV", 1, kReadIters, Clock::now() - start);
+
+    start = Clock::now();
+    for (uint64_t i = 0; i < kReadIters; ++i) {
+        int64_t val = cfg.get<static_cast<Bench10Parm>(1)>();
+        sink(val);
+    }
+    report("get", "IntUpdatableCV", 1, kReadIters, Clock::now() - start);
+}
+
+/// Time string-key lookups, for a hit and a miss, in each config size
+template <typename TConfigEnum>
+void benchKeyLookup(const char* size)
+{
+    ConfigTemplate<TConfigEnum> cfg(std::map<std::string, std::string>{});
+    std::string_view hit = ConfigRegistry<TConfigEnum>::kKeys[ConfigEnumCount<TConfigEnum>::value - 1];
+    TConfigEnum parm;
+
+    auto start = Clock::now();
+    for (uint64_t i = 0; i < kReadIters; ++i) {
+        bool found = cfg.parmForKey(hit, parm);
+        sink(found);
+    }
+    report("parmForKey", std::string(size) + "/hit", 1, kReadIters, Clock::now() - start);
+
+    start = Clock::now();
+    for (uint64_t i = 0; i < kReadIters; ++i) {
+        bool found = cfg.parmForKey("NO_SUCH_KEY", parm);
+        sink(found);
+    }
+    report("parmForKey", std::string(size) + "/miss", 1, kReadIters, Clock::now() - start);
+
+    start = Clock::now();
+    for (uint64_t i = 0; i < kReadIters; ++i) {
+        int64_t val = cfg.template as_<int64_t>(hit);
+        sink(val);
+    }
+    report("asByKey", std::string(size) + "/int64", 1, kReadIters, Clock::now() - start);
+}
+
+/// Time constructing a config, with no overrides and with every parm overridden
+template <typename TConfigEnum>
+void benchConstruct(const char* size)
+{
+    constexpr std::size_t kCount = ConfigEnumCount<TConfigEnum>::value;
+    const uint64_t iters = 2000000 / kCount;
+    std::map<std::string, std::string> none;
+    std::map<std::string, std::string> all;
+    for (std::size_t i = 0; i < kCount; ++i) {
+        all.emplace(ConfigRegistry<TConfigEnum>::kKeys[i], (i % 6 == 2 || i % 6 == 4) ? "false" : "7");
+    }
+    ConfigOverrides noneView(none);
+    ConfigOverrides allView(all);
+
+    auto start = Clock::now();
+    for (uint64_t i = 0; i < iters; ++i) {
+        ConfigTemplate<TConfigEnum> cfg(noneView);
+        sink(cfg);
+    }
+    report("construct", std::string(size) + "/defaults", 1, iters, Clock::now() - start);
+
+    start = Clock::now();
+    for (uint64_t i = 0; i < iters; ++i) {
+        ConfigTemplate<TConfigEnum> cfg(allView);
+        sink(cfg);
+    }
+    report("construct", std::string(size) + "/overridden", 1, iters, Clock::now() - start);
+}
+
+/// Time a per-query overlay with one and four overrides: make it, override,
+/// read an overridden and an inherited parm, and drop it
+template <typename TConfigEnum>
+void benchOverlay(const char* size)
+{
+    constexpr uint64_t kIters = 2000000;
+    ConfigTemplate<TConfigEnum> cfg(std::map<std::string, std::string>{});
+    const auto roInt = static_cast<TConfigEnum>(0);
+    const auto str = static_cast<TConfigEnum>(3);
+
+    auto start = Clock::now();
+    for (uint64_t i = 0; i < kIters; ++i) {
+        ConfigOverlay<TConfigEnum> overlay(cfg);
+        overlay.overrideValue(roInt, "4096");
+        sink(overlay.template as_<int32_t>(roInt));
+        sink(overlay.template as_<int32_t>(static_cast<TConfigEnum>(1)));
+    }
+    report("overlay", std::string(size) + "/1", 1, kIters, Clock::now() - start);
+
+    start = Clock::now();
+    for (uint64_t i = 0; i < kIters; ++i) {
+        ConfigOverlay<TConfigEnum> overlay(cfg);
+        for (std::size_t p = 0; p < 4; ++p) {
+            overlay.overrideValue(static_cast<TConfigEnum>(p), "1");
+        }
+        sink(overlay.template as_<int32_t>(roInt));
+        sink(overlay.template as_<int32_t>(str));
+    }
+    report("overlay", std::string(size) + "/4", 1, kIters, Clock::now() - start);
+}
+
+/// Time a full scrape: capture every value and render it as Prometheus text
+/// and as JSON
+template <typename TConfigEnum>
+void benchExport(const char* size)
+{
+    const uint64_t iters = 2000000 / ConfigEnumCount<TConfigEnum>::value;
+    ConfigTemplate<TConfigEnum> cfg(std::map<std::string, std::string>{});
+    ConfigExport<TConfigEnum> scrape(cfg);
+    std::vector<char> buf(ConfigEnumCount<TConfigEnum>::value * 128);
+
+    auto start = Clock::now();
+    for (uint64_t i = 0; i < iters; ++i) {
+        scrape.capture();
+        sink(scrape.renderPrometheus(buf.data(), buf.size()));
+    }
+    report("export", std::string(size) + "/prometheus", 1, iters, Clock::now() - start);
+
+    start = Clock::now();
+    for (uint64_t i = 0; i < iters; ++i) {
+        scrape.capture();
+        sink(scrape.renderJson(buf.data(), buf.size()));
+    }
+    report("export", std::string(size) + "/json", 1, iters, Clock::now() - start);
+}
+
+/// Time set() of one shared parm from a number of threads at once
+void benchSet(unsigned threads)
+{
+    constexpr uint64_t kSetsPerThread = 200000;
+    ConfigTemplate<Bench10Parm> cfg(std::map<std::string, std::string>{});
+    const auto parm = static_cast<Bench10Parm>(1);
+    const std::string vals[2] = { "4096", "8192" };
+
+    std::atomic<bool> go{false};
+    std::vector<std::thread> workers;
+    for (unsigned t = 0; t < threads; ++t) {
+        workers.emplace_back([&] {
+            while (!go.load(std::memory_order_acquire)) {
+            }
+            for (uint64_t i = 0; i < kSetsPerThread; ++i) {
+                cfg.set(parm, vals[i & 1]);
+            }
+        });
+    }
+    auto start = Clock::now();
+    go.store(true, std::memory_order_release);
+    for (auto& w : workers) {
+        w.join();
+    }
+    report("set", "IntUpdatableCV", threads, kSetsPerThread * threads, Clock::now() - start);
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    if (argc > 1) {
+        gOut = std::fopen(argv[1], "w");
+        if (gOut == nullptr) {
+            std::perror(argv[1]);
+            return EXIT_FAILURE;
+        }
+    }
+    std::fprintf(gOut, "benchmark,case,threads,iterations,ns_per_op\n");
+
+    benchReads();
+
+    benchKeyLookup<Bench10Parm>("10");
+    benchKeyLookup<Bench100Parm>("100");
+    benchKeyLookup<Bench1000Parm>("1000");
+
+    benchConstruct<Bench10Parm>("10");
+    benchConstruct<Bench100Parm>("100");
+    benchConstruct<Bench1000Parm>("1000");
+
+    benchOverlay<Bench10Parm>("10");
+    benchOverlay<Bench1000Parm>("1000");
+
+    benchExport<Bench10Parm>("10");
+    benchExport<Bench1000Parm>("1000");
+
+    for (unsigned threads = 1; threads <= 64; threads *= 2) {
+        benchSet(threads);
+    }
+
+    if (gOut != stdout) {
+        std::fclose(gOut);
+    }
+    return EXIT_SUCCESS;
+}
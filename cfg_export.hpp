@@ -0,0 +1,282 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <charconv>
+#include <cstdint>
+#include <cstring>
+#include <string_view>
+#include "cfg_template.hpp"
+
+/// Return the name of a storage kind, as used by the renderers
+inline const char* cvKindName(CVKind kind)
+{
+    switch (kind) {
+    case CVKind::Int8: return "int8";
+    case CVKind::Int16: return "int16";
+    case CVKind::Int32: return "int32";
+    case CVKind::Int64: return "int64";
+    case CVKind::Bool: return "bool";
+    case CVKind::Str: return "string";
+    case CVKind::Enum: return "enum";
+    }
+    return "unknown";
+}
+
+/**
+   One config parm as captured by ConfigExport.
+
+   Which value field is meaningful depends on kind: intVal for the integer
+   kinds, boolVal for Bool, strVal for Str, and both intVal and strVal (the
+   enumerator's name) for Enum.  The views stay valid for the config's
+   lifetime.
+*/
+template <typename TConfigEnum>
+struct ConfigParmView {
+    TConfigEnum parm;
+    std::string_view key;
+    std::string_view help;
+    CVKind kind;
+    bool updatable;
+    bool boolVal;
+    int64_t intVal;
+    std::string_view strVal;
+};
+
+/**
+   Bulk export of every parm in a config.
+
+   capture() takes a consistent snapshot of all values: it reads them between
+   two loads of the config version and retries if a set() landed in between.
+   The views are then iterated, or rendered as Prometheus text or JSON into a
+   caller-provided buffer.  Enum slots with no value in the config, such as
+   every slot of a moved-from config, have no view.  Keys, help text and kinds are filled in once at
+   construction, and nothing is allocated after that, so an export object
+   kept across scrapes costs no allocation per scrape.
+*/
+template <typename TConfigEnum>
+class ConfigExport
+{
+public:
+    using Config = ConfigTemplate<TConfigEnum>;
+    using View = ConfigParmView<TConfigEnum>;
+
+    /// Constructor
+    /// @param[in] cfg Config to export.  Must outlive the export.
+    explicit ConfigExport(const Config& cfg) : mCfg(cfg)
+    {
+        for (std::size_t i = 0; i < kCount; ++i) {
+            if (const AbstractCV* val = mCfg.find(static_cast<TConfigEnum>(i))) {
+                mViews[mSize++] = View{ static_cast<TConfigEnum>(i), val->key(), val->help(), val->kind(),
+                                        val->updatable(), false, 0, {} };
+            }
+        }
+        capture();
+    }
+
+    /// Read every value as of one config version.  Values the config no
+    /// longer has, e.g. after it was moved from, keep their last capture.
+    /// @return The version the values were read at
+    uint64_t capture() {
+        mVersion = mCfg.readConsistent([this] {
+            for (std::size_t i = 0; i < mSize; ++i) {
+                if (const AbstractCV* val = mCfg.find(mViews[i].parm)) {
+                    read(*val, mViews[i]);
+                }
+            }
+        });
+        return mVersion;
+    }
+
+    /// Return the config version of the last capture()
+    uint64_t version() const { return mVersion; }
+
+    const View* begin() const { return mViews.data(); }
+    const View* end() const { return mViews.data() + mSize; }
+
+    /// Render the captured values in the Prometheus text format.
+    ///
+    /// Each parm is a gauge named prefix_key, lowercased, with its help text.
+    /// Integers and bools are the gauge value; strings and enums are an info
+    /// style gauge of 1 with the value in a "value" label.
+    /// Like snprintf, the output is cut off at size bytes but the full length
+    /// is returned, so a caller can retry with a larger buffer.  No NUL is
+    /// written.
+    /// @param[out] buf Buffer to render into
+    /// @param[in] size Size of buf
+    /// @param[in] prefix Metric name prefix
+    /// @return Length of the full rendering
+    std::size_t renderPrometheus(char* buf, std::size_t size, std::string_view prefix = "config") const {
+        Writer out{ buf, size };
+        for (const View& v : *this) {
+            out.put("# HELP ");
+            putMetricName(out, prefix, v.key);
+            out.put(' ');
+            for (char c : v.help) {
+                if (c == '\\') {
+                    out.put("\\\\");
+                } else if (c == '\n') {
+                    out.put("\\n");
+                } else {
+                    out.put(c);
+                }
+            }
+            out.put("\n# TYPE ");
+            putMetricName(out, prefix, v.key);
+            out.put(" gauge\n");
+            putMetricName(out, prefix, v.key);
+            switch (v.kind) {
+            case CVKind::Bool:
+                out.put(v.boolVal ? " 1\n" : " 0\n");
+                break;
+            case CVKind::Str:
+            case CVKind::Enum:
+                out.put("{value=\"");
+                for (char c : v.strVal) {
+                    if (c == '\\' || c == '"') {
+                        out.put('\\');
+                        out.put(c);
+                    } else if (c == '\n') {
+                        out.put("\\n");
+                    } else {
+                        out.put(c);
+                    }
+                }
+                out.put("\"} 1\n");
+                break;
+            default:
+                out.put(' ');
+                out.putInt(v.intVal);
+                out.put('\n');
+                break;
+            }
+        }
+        return out.len;
+    }
+
+    /// Render the captured values as a JSON object:
+    ///
+    ///     {"version":N,"parms":[{"key":"K","type":"int32","updatable":false,
+    ///       "value":1,"help":"..."}, ...]}
+    ///
+    /// Output is cut off and sized as for renderPrometheus().
+    std::size_t renderJson(char* buf, std::size_t size) const {
+        Writer out{ buf, size };
+        out.put("{\"version\":");
+        out.putInt(static_cast<int64_t>(mVersion));
+        out.put(",\"parms\":[");
+        bool first = true;
+        for (const View& v : *this) {
+            out.put(first ? "{\"key\":" : ",{\"key\":");
+            first = false;
+            putJsonString(out, v.key);
+            out.put(",\"type\":\"");
+            out.put(cvKindName(v.kind));
+            out.put(v.updatable ? "\",\"updatable\":true,\"value\":" : "\",\"updatable\":false,\"value\":");
+            switch (v.kind) {
+            case CVKind::Bool: out.put(v.boolVal ? "true" : "false"); break;
+            case CVKind::Str:
+            case CVKind::Enum: putJsonString(out, v.strVal); break;
+            default: out.putInt(v.intVal); break;
+            }
+            out.put(",\"help\":");
+            putJsonString(out, v.help);
+            out.put('}');
+        }
+        out.put("]}");
+        return out.len;
+    }
+
+private:
+    static constexpr std::size_t kCount = ConfigEnumCount<TConfigEnum>::value;
+
+    /// Bounded append into a caller buffer that keeps counting past the end
+    struct Writer {
+        char* buf;
+        std::size_t size;
+        std::size_t len = 0;
+
+        void put(char c) {
+            if (len < size) {
+                buf[len] = c;
+            }
+            ++len;
+        }
+        void put(std::string_view s) {
+            if (len < size) {
+                std::memcpy(buf + len, s.data(), std::min(s.size(), size - len));
+            }
+            len += s.size();
+        }
+        void putInt(int64_t v) {
+            char tmp[24];
+            auto res = std::to_chars(tmp, tmp + sizeof(tmp), v);
+            put(std::string_view(tmp, res.ptr - tmp));
+        }
+    };
+
+    /// Read a value's raw form.  Only the field its kind uses is read, so a
+    /// concurrent set() can't make the read throw; capture() retries it.
+    static void read(const AbstractCV& val, View& out) {
+        switch (out.kind) {
+        case CVKind::Bool:
+            out.boolVal = val.asBool();
+            break;
+        case CVKind::Str: {
+            CVStrBuf unused;
+            out.strVal = val.asStrView(unused);
+            break;
+        }
+        case CVKind::Enum: {
+            CVStrBuf unused;
+            out.intVal = val.asInt();
+            out.strVal = val.asStrView(unused);
+            break;
+        }
+        default:
+            out.intVal = val.asInt();
+            break;
+        }
+    }
+
+    /// Write prefix_key, lowercased, with characters a metric name can't
+    /// hold replaced by '_'
+    static void putMetricName(Writer& out, std::string_view prefix, std::string_view key) {
+        out.put(prefix);
+        out.put('_');
+        for (char c : key) {
+            if (c >= 'A' && c <= 'Z') {
+                out.put(static_cast<char>(c - 'A' + 'a'));
+            } else if ((c >= 'a' && c <= 'z') || (c >= '0' && c <= '9') || c == '_') {
+                out.put(c);
+            } else {
+                out.put('_');
+            }
+        }
+    }
+
+    static void putJsonString(Writer& out, std::string_view s) {
+        static constexpr char kHex[] = "0123456789abcdef";
+        out.put('"');
+        for (char c : s) {
+            auto u = static_cast<unsigned char>(c);
+            if (c == '"' || c == '\\') {
+                out.put('\\');
+                out.put(c);
+            } else if (u < 0x20) {
+                out.put("\\u00");
+                out.put(kHex[u >> 4]);
+                out.put(kHex[u & 0xf]);
+            } else {
+                out.put(c);
+            }
+        }
+        out.put('"');
+    }
+
+    const Config& mCfg;
+    uint64_t mVersion = 0;
+    /// Views of the slots the config has values for, in enum order
+    std::array<View, kCount> mViews{};
+    std::size_t mSize = 0;
+};
@@ -0,0 +1,166 @@
+#pragma once
+
+#include <algorithm>
+#include <bitset>
+#include <map>
+#include <memory>
+#include <memory_resource>
+#include <string>
+#include <utility>
+#include <vector>
+#include "cfg_template.hpp"
+
+/**
+   Config that layers a few per-instance overrides over a shared base.
+
+   The base is a process-wide, immutable ConfigTemplate.  A LayeredConfig only
+   stores the values it overrides, in a small sparse table, and falls through
+   to the base for everything else.  This keeps the per-instance footprint
+   proportional to the number of overrides, which is usually zero or one for a
+   session.
+
+   set() is copy-on-write: the first set() of an updatable parm copies it into
+   the sparse table, so changes never leak into the shared base.  A
+   LayeredConfig is not safe to set() while other threads read it.
+
+   The overrides are checked against the enum's ConfigConstraints together
+   with the base values when the LayeredConfig is built and on each set().
+*/
+template <typename TConfigEnum>
+class LayeredConfig
+{
+public:
+    using Config = ConfigTemplate<TConfigEnum>;
+
+    /// Constructor
+    /// Throws std::out_of_range if an override key is not a known config key,
+    /// and std::invalid_argument if the overrides break a config constraint.
+    /// @param[in] base Shared config to fall through to
+    /// @param[in] overrides List of key/value pairs for specific config parms
+    ///            that are overridden for this instance only.
+    /// @param[in] resource Memory resource for the overridden values
+    LayeredConfig(std::shared_ptr<const Config> base,
+                  const std::map<std::string, std::string>& overrides = {},
+                  std::pmr::memory_resource* resource = std::pmr::get_default_resource())
+        : mBase(std::move(base)), mOverrides(resource), mResource(resource)
+    {
+        for (auto& o : overrides) {
+            TConfigEnum parm;
+            if (!mBase->parmForKey(o.first, parm)) {
+                throw std::out_of_range("Unknown config key: " + o.first);
+            }
+            put(parm, mBase->find(parm)->rebind(o.second, mResource));
+        }
+        Config::checkConstraints(*this);
+    }
+
+    /// Get a config value as a specific type
+    /// Throws std::out_of_range if the parm was never registered.
+    /// @tparam T The type to get the value as.
+    /// @param[in] parm Config parm to lookup
+    template <typename T>
+    T as_(TConfigEnum parm) const {
+        T returnVal;
+        if (!tryAs_(parm, returnVal)) {
+            throw std::out_of_range("Unknown config parm: " + std::to_string(enumIndex(parm)));
+        }
+        return returnVal;
+    }
+
+    /// Get a config value as a specific type without throwing for unknown parms.
+    /// @return false if the parm is not registered in the base config
+    template <typename T>
+    bool tryAs_(TConfigEnum parm, T& returnVal) const {
+        const AbstractCV* val = find(parm);
+        if (val == nullptr) {
+            return false;
+        }
+        convertToType(*val, returnVal);
+        return true;
+    }
+
+    /// Get a config value as a string without allocating.
+    /// See ConfigTemplate::asStrView().
+    std::string_view asStrView(TConfigEnum parm, CVStrBuf& scratch) const {
+        const AbstractCV* val = find(parm);
+        if (val == nullptr) {
+            throw std::out_of_range("Unknown config parm: " + std::to_string(enumIndex(parm)));
+        }
+        return val->asStrView(scratch);
+    }
+
+    /// Find the config value for a parm, preferring this instance's override
+    /// @return The config value or nullptr if the parm is not registered
+    const AbstractCV* find(TConfigEnum parm) const noexcept {
+        std::size_t idx = enumIndex(parm);
+        if (idx < kCount && mOverridden[idx]) {
+            return slot(idx)->second.get();
+        }
+        return mBase->find(parm);
+    }
+
+    /// Return true if this instance overrides the parm
+    bool overridden(TConfigEnum parm) const noexcept {
+        std::size_t idx = enumIndex(parm);
+        return idx < kCount && mOverridden[idx];
+    }
+
+    /// Set a config value for this instance only
+    /// Throws for unknown or read-only parms, like ConfigTemplate::set(), and
+    /// std::invalid_argument if the value would break a config constraint.
+    /// @param[in] parm Config parm to set
+    /// @param[in] newVal New value to set.
+    void set(TConfigEnum parm, const std::string& newVal) {
+        const AbstractCV* val = find(parm);
+        if (val == nullptr) {
+            throw std::out_of_range("Unknown config parm: " + std::to_string(enumIndex(parm)));
+        }
+        if (!val->updatable()) {
+            throw std::runtime_error("Read-only config value.  Set is not supported: " + std::string(val->key()));
+        }
+        if (overridden(parm)) {
+            if constexpr (Config::kHasConstraints) {
+                // Only checked, so the copy doesn't come out of mResource
+                Config::checkConstraints(*this, parm, val->rebind(newVal, std::pmr::get_default_resource()).get());
+            }
+            slot(enumIndex(parm))->second->set(newVal);
+        } else {
+            std::shared_ptr<AbstractCV> next = val->rebind(newVal, mResource);
+            Config::checkConstraints(*this, parm, next.get());
+            put(parm, std::move(next));
+        }
+    }
+
+    /// Return the shared base config
+    const Config& base() const { return *mBase; }
+
+private:
+    static constexpr std::size_t kCount = ConfigEnumCount<TConfigEnum>::value;
+
+    using Override = std::pair<uint32_t, std::shared_ptr<AbstractCV>>;
+
+    /// Return the sparse table entry for an overridden slot
+    typename std::pmr::vector<Override>::const_iterator slot(std::size_t idx) const {
+        return std::lower_bound(mOverrides.begin(), mOverrides.end(), idx,
+                                [](const Override& o, std::size_t i) { return o.first < i; });
+    }
+
+    /// Add or replace the override for a parm
+    void put(TConfigEnum parm, std::shared_ptr<AbstractCV> val) {
+        std::size_t idx = enumIndex(parm);
+        auto it = mOverrides.begin() + (slot(idx) - mOverrides.cbegin());
+        if (mOverridden[idx]) {
+            it->second = std::move(val);
+        } else {
+            mOverrides.emplace(it, static_cast<uint32_t>(idx), std::move(val));
+            mOverridden[idx] = true;
+        }
+    }
+
+    std::shared_ptr<const Config> mBase;
+    /// Slots that have an entry in mOverrides
+    std::bitset<kCount> mOverridden;
+    /// Overridden values sorted by slot
+    std::pmr::vector<Override> mOverrides;
+    std::pmr::memory_resource* mResource;
+};
@@ -0,0 +1,481 @@
+#pragma once
+
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#include "cfg_template.hpp"
+
+/// Syntax of a config source
+enum class ConfigFormat : uint8_t {
+    /// JSON if the first non-blank character is '{', otherwise KeyValue
+    Auto,
+    /// One key=value per line.  Lines starting with # or ; are comments.
+    KeyValue,
+    /// KeyValue plus [section] headers.  Sections only group keys; keys must
+    /// still be unique across the whole file.
+    Ini,
+    /// A flat JSON object of keys to strings, numbers or booleans
+    Json
+};
+
+/**
+   Config overrides parsed from a key=value, INI or JSON source.
+
+   The source text is read into one buffer and parsed in a single pass.  Keys
+   and values are views into that buffer (JSON escapes are decoded in place),
+   so the parse allocates nothing per entry.  Pass overrides() straight to a
+   ConfigTemplate constructor; no std::map is built.  The source must outlive
+   any ConfigOverrides made from it.
+*/
+class ConfigSource {
+public:
+    using Pair = std::pair<std::string_view, std::string_view>;
+
+    /// Constructor
+    /// Throws std::invalid_argument with the line number if the text is malformed.
+    /// @param[in] text Config text to parse
+    /// @param[in] format Syntax of the text
+    explicit ConfigSource(std::string_view text, ConfigFormat format = ConfigFormat::Auto)
+        : mText(text.begin(), text.end())
+    {
+        parse(format);
+    }
+
+    /// Read and parse a config file
+    /// Throws std::runtime_error if the file can't be read, and
+    /// std::invalid_argument if it is malformed.
+    /// @param[in] path File to read
+    /// @param[in] format Syntax of the file
+    static ConfigSource fromFile(const std::string& path, ConfigFormat format = ConfigFormat::Auto)
+    {
+        std::ifstream in(path, std::ios::binary);
+        if (!in) {
+            throw std::runtime_error("Cannot open config file: " + path);
+        }
+        ConfigSource src;
+        src.mText.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+        if (in.bad()) {
+            throw std::runtime_error("Cannot read config file: " + path);
+        }
+        src.parse(format);
+        return src;
+    }
+
+    // The pairs point into mText, whose buffer survives a move but not a copy
+    ConfigSource(ConfigSource&&) = default;
+    ConfigSource& operator=(ConfigSource&&) = default;
+    ConfigSource(const ConfigSource&) = delete;
+    ConfigSource& operator=(const ConfigSource&) = delete;
+
+    /// Key/value pairs in the order they appear in the source
+    const std::vector<Pair>& pairs() const { return mPairs; }
+
+    /// Return a hashed view of the pairs to construct a ConfigTemplate from
+    /// Throws std::invalid_argument if a key appears more than once.
+    /// @param[in] resource Memory resource for the view, e.g. the config's
+    ConfigOverrides overrides(std::pmr::memory_resource* resource = std::pmr::get_default_resource()) const {
+        return ConfigOverrides(mPairs, resource);
+    }
+
+private:
+    ConfigSource() = default;
+
+    void parse(ConfigFormat format)
+    {
+        if (format == ConfigFormat::Auto) {
+            format = ConfigFormat::KeyValue;
+            for (char c : mText) {
+                if (!isSpace(c)) {
+                    format = (c == '{') ? ConfigFormat::Json : ConfigFormat::KeyValue;
+                    break;
+                }
+            }
+        }
+        if (format == ConfigFormat::Json) {
+            parseJson();
+        } else {
+            parseLines(format == ConfigFormat::Ini);
+        }
+    }
+
+    static bool isSpace(char c) { return c == ' ' || c == '\t' || c == '\r' || c == '\n'; }
+
+    static std::string_view trim(std::string_view s)
+    {
+        while (!s.empty() && isSpace(s.front())) {
+            s.remove_prefix(1);
+        }
+        while (!s.empty() && isSpace(s.back())) {
+            s.remove_suffix(1);
+        }
+        return s;
+    }
+
+    [[noreturn]] void fail(const char* what, std::size_t pos) const
+    {
+        std::size_t line = 1;
+        for (std::size_t i = 0; i < pos && i < mText.size(); ++i) {
+            line += (mText[i] == '\n');
+        }
+        throw std::invalid_argument(std::string("Config source line ") + std::to_string(line) + ": " + what);
+    }
+
+    /// Parse KeyValue or Ini text
+    void parseLines(bool sections)
+    {
+        std::string_view text(mText.data(), mText.size());
+        std::size_t pos = 0;
+        while (pos < text.size()) {
+            std::size_t eol = text.find('\n', pos);
+            if (eol == std::string_view::npos) {
+                eol = text.size();
+            }
+            std::string_view line = trim(text.substr(pos, eol - pos));
+            if (!line.empty() && line.front() != '#' && line.front() != ';') {
+                if (line.front() == '[') {
+                    if (!sections || line.back() != ']') {
+                        fail("unexpected section header", pos);
+                    }
+                } else {
+                    std::size_t eq = line.find('=');
+                    if (eq == std::string_view::npos) {
+                        fail("expected key=value", pos);
+                    }
+                    std::string_view key = trim(line.substr(0, eq));
+                    std::string_view val = trim(line.substr(eq + 1));
+                    if (key.empty()) {
+                        fail("empty key", pos);
+                    }
+                    if (val.size() >= 2 && val.front() == '"' && val.back() == '"') {
+                        val = val.substr(1, val.size() - 2);
+                    }
+                    mPairs.emplace_back(key, val);
+                }
+            }
+            pos = eol + 1;
+        }
+    }
+
+    /// Parse a flat JSON object
+    void parseJson()
+    {
+        std::size_t pos = 0;
+        skipSpace(pos);
+        expect('{', pos);
+        skipSpace(pos);
+        if (pos < mText.size() && mText[pos] == '}') {
+            ++pos;
+        } else {
+            while (true) {
+                std::string_view key = jsonString(pos);
+                skipSpace(pos);
+                expect(':', pos);
+                skipSpace(pos);
+                mPairs.emplace_back(key, jsonValue(pos));
+                skipSpace(pos);
+                if (pos < mText.size() && mText[pos] == ',') {
+                    ++pos;
+                    skipSpace(pos);
+                    continue;
+                }
+                expect('}', pos);
+                break;
+            }
+        }
+        skipSpace(pos);
+        if (pos != mText.size()) {
+            fail("trailing characters after JSON object", pos);
+        }
+    }
+
+    void skipSpace(std::size_t& pos) const
+    {
+        while (pos < mText.size() && isSpace(mText[pos])) {
+            ++pos;
+        }
+    }
+
+    void expect(char c, std::size_t& pos) const
+    {
+        if (pos >= mText.size() || mText[pos] != c) {
+            fail(c == '}' ? "expected ',' or '}'" : "unexpected character", pos);
+        }
+        ++pos;
+    }
+
+    /// Parse a JSON value.  Strings are decoded; numbers and booleans are
+    /// returned as written.
+    std::string_view jsonValue(std::size_t& pos)
+    {
+        if (pos < mText.size() && mText[pos] == '"') {
+            return jsonString(pos);
+        }
+        std::size_t start = pos;
+        while (pos < mText.size() && mText[pos] != ',' && mText[pos] != '}' && !isSpace(mText[pos])) {
+            ++pos;
+        }
+        std::string_view tok(mText.data() + start, pos - start);
+        if (tok.empty() || tok.front() == '{' || tok.front() == '[' || tok == "null") {
+            fail("config values must be strings, numbers or booleans", start);
+        }
+        return tok;
+    }
+
+    /// Parse a JSON string, decoding escapes over the source text
+    std::string_view jsonString(std::size_t& pos)
+    {
+        expect('"', pos);
+        char* out = mText.data() + pos;
+        char* start = out;
+        while (true) {
+            if (pos >= mText.size()) {
+                fail("unterminated string", pos);
+            }
+            char c = mText[pos++];
+            if (c == '"') {
+                break;
+            }
+            if (c != '\\') {
+                *out++ = c;
+                continue;
+            }
+            if (pos >= mText.size()) {
+                fail("unterminated string", pos);
+            }
+            switch (mText[pos++]) {
+            case '"': *out++ = '"'; break;
+            case '\\': *out++ = '\\'; break;
+            case '/': *out++ = '/'; break;
+            case 'b': *out++ = '\b'; break;
+            case 'f': *out++ = '\f'; break;
+            case 'n': *out++ = '\n'; break;
+            case 'r': *out++ = '\r'; break;
+            case 't': *out++ = '\t'; break;
+            case 'u': out = utf8(jsonCodePoint(pos), out); break;
+            default: fail("invalid escape", pos - 1);
+            }
+        }
+        return std::string_view(start, out - start);
+    }
+
+    /// Parse the 4 hex digits of a \u escape
+    uint32_t jsonCodePoint(std::size_t& pos) const
+    {
+        if (pos + 4 > mText.size()) {
+            fail("invalid \\u escape", pos);
+        }
+        uint32_t cp = 0;
+        for (int i = 0; i < 4; ++i) {
+            char c = mText[pos++];
+            cp <<= 4;
+            if (c >= '0' && c <= '9') {
+                cp |= c - '0';
+            } else if (c >= 'a' && c <= 'f') {
+                cp |= c - 'a' + 10;
+            } else if (c >= 'A' && c <= 'F') {
+                cp |= c - 'A' + 10;
+            } else {
+                fail("invalid \\u escape", pos - 1);
+            }
+        }
+        if (cp >= 0xD800 && cp <= 0xDFFF) {
+            fail("surrogate \\u escapes are not supported", pos - 6);
+        }
+        return cp;
+    }
+
+    /// Encode a code point as UTF-8.  The encoding is never longer than the
+    /// 6 character escape it replaces, so it can be written in place.
+    static char* utf8(uint32_t cp, char* out)
+    {
+        if (cp < 0x80) {
+            *out++ = static_cast<char>(cp);
+        } else if (cp < 0x800) {
+            *out++ = static_cast<char>(0xC0 | (cp >> 6));
+            *out++ = static_cast<char>(0x80 | (cp & 0x3F));
+        } else {
+            *out++ = static_cast<char>(0xE0 | (cp >> 12));
+            *out++ = static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+            *out++ = static_cast<char>(0x80 | (cp & 0x3F));
+        }
+        return out;
+    }
+
+    std::vector<char> mText;
+    std::vector<Pair> mPairs;
+};
+
+/**
+   Reloads a config file into a ConfigTemplate when the file changes.
+
+   Changes are detected with inotify on the file's directory, so both in-place
+   writes and editors that rename a new file over the old one are seen, and
+   nothing is re-read while the file is unchanged.  Only finished writes and
+   renames count: a newly created file is read once it is closed, not while
+   it is still empty or half written.  A reload compares the new
+   file against the last one applied and passes only the values that changed
+   to setMany(), so subscribers hear about just those parms and the batch is
+   applied under one version change.  A key dropped from the file keeps its
+   current value.
+
+   Not thread-safe; poll from one thread, e.g. an event loop that waits on fd().
+*/
+template <typename TConfigEnum>
+class ConfigFileWatcher {
+public:
+    using Config = ConfigTemplate<TConfigEnum>;
+
+    /// Result of a reload: each changed key and how applying it went
+    using Changes = std::vector<std::pair<std::string, SetError>>;
+
+    /// Constructor
+    /// The current file is taken as already applied, e.g. because cfg was
+    /// constructed from it.  Throws std::runtime_error if the file can't be
+    /// read or watched.
+    /// @param[in] cfg Config to apply changes to.  Must outlive the watcher.
+    /// @param[in] path Config file to watch
+    /// @param[in] format Syntax of the file
+    ConfigFileWatcher(Config& cfg, std::string path, ConfigFormat format = ConfigFormat::Auto)
+        : mCfg(cfg)
+        , mPath(std::move(path))
+        , mFormat(format)
+        , mSource(ConfigSource::fromFile(mPath, mFormat))
+        , mApplied(mSource.overrides())
+    {
+        std::size_t slash = mPath.rfind('/');
+        std::string dir = (slash == std::string::npos) ? "." : mPath.substr(0, slash == 0 ? 1 : slash);
+        mName = (slash == std::string::npos) ? mPath : mPath.substr(slash + 1);
+        mFd = ::inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+        if (mFd < 0 || ::inotify_add_watch(mFd, dir.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO) < 0) {
+            int err = errno;
+            if (mFd >= 0) {
+                ::close(mFd);
+            }
+            throw std::runtime_error("Cannot watch config file: " + mPath + ": " + std::strerror(err));
+        }
+    }
+
+    ConfigFileWatcher(const ConfigFileWatcher&) = delete;
+    ConfigFileWatcher& operator=(const ConfigFileWatcher&) = delete;
+
+    ~ConfigFileWatcher() { ::close(mFd); }
+
+    /// File descriptor that becomes readable when the directory changes
+    int fd() const { return mFd; }
+
+    /// Wait for the file to change and reload it if it did
+    /// Throws std::runtime_error if the change events can't be read.
+    /// @param[in] timeoutMs How long to wait; 0 returns immediately and -1
+    ///            waits until a change arrives
+    /// @return See reload().  Empty if the file did not change.
+    Changes poll(int timeoutMs = 0)
+    {
+        struct pollfd pfd = { mFd, POLLIN, 0 };
+        if (::poll(&pfd, 1, timeoutMs) <= 0 || !drainEvents()) {
+            return {};
+        }
+        return reload();
+    }
+
+    /// Re-read the file and apply the values that changed since the last reload
+    ///
+    /// Changed keys that can never be set at runtime, because they are unknown
+    /// or read-only, are reported with SetError::UnknownParm or
+    /// SetError::ReadOnly and left out.  The rest go through setMany(), so
+    /// they are all-or-nothing: if any is rejected, none is applied and the
+    /// next reload will try them again.  Throws std::invalid_argument if the
+    /// file is malformed, leaving the config untouched.
+    /// @return Each changed key with its result, in file order
+    Changes reload()
+    {
+        ConfigSource next = ConfigSource::fromFile(mPath, mFormat);
+        ConfigOverrides nextIndex = next.overrides();
+        std::vector<std::pair<std::string, std::string>> updates;
+        for (auto& p : next.pairs()) {
+            const std::string_view* prev = mApplied.find(p.first);
+            if (prev == nullptr || *prev != p.second) {
+                updates.emplace_back(p.first, p.second);
+            }
+        }
+        Changes changes;
+        if (updates.empty()) {
+            return changes;
+        }
+
+        // Keys that can't be set would fail every batch they are in, so they
+        // are reported on their own and the rest still get applied
+        changes.reserve(updates.size());
+        std::vector<std::pair<std::string, std::string>> settable;
+        std::vector<std::size_t> settableAt;
+        for (auto& u : updates) {
+            const AbstractCV* val = mCfg.findByKey(u.first);
+            SetError err = val == nullptr ? SetError::UnknownParm
+                         : !val->updatable() ? SetError::ReadOnly : SetError::None;
+            if (err == SetError::None) {
+                settableAt.push_back(changes.size());
+                settable.emplace_back(u.first, std::move(u.second));
+            }
+            changes.emplace_back(std::move(u.first), err);
+        }
+        bool ok = true;
+        if (!settable.empty()) {
+            std::vector<SetError> errs = mCfg.setMany(settable);
+            for (std::size_t i = 0; i < settable.size(); ++i) {
+                changes[settableAt[i]].second = errs[i];
+                ok = ok && errs[i] == SetError::None;
+            }
+        }
+        if (ok) {
+            // Keys left out are taken as seen, so they are reported only once
+            mSource = std::move(next);
+            mApplied = std::move(nextIndex);
+        }
+        return changes;
+    }
+
+private:
+    /// Read all pending inotify events
+    /// @return true if any of them was for the watched file
+    bool drainEvents()
+    {
+        alignas(struct inotify_event) char buf[4096];
+        bool hit = false;
+        while (true) {
+            ssize_t n = ::read(mFd, buf, sizeof(buf));
+            if (n < 0 && errno == EINTR) {
+                continue;
+            } else if (n < 0 && errno != EAGAIN) {
+                throw std::runtime_error("Cannot read config file events: " + mPath + ": " + std::strerror(errno));
+            } else if (n <= 0) {
+                break;
+            }
+            for (char* p = buf; p < buf + n;) {
+                auto* ev = reinterpret_cast<struct inotify_event*>(p);
+                hit = hit || (ev->len > 0 && mName == ev->name);
+                p += sizeof(struct inotify_event) + ev->len;
+            }
+        }
+        return hit;
+    }
+
+    Config& mCfg;
+    std::string mPath;
+    /// File name of mPath, to match against inotify events on its directory
+    std::string mName;
+    ConfigFormat mFormat;
+    /// Last source applied to the config
+    ConfigSource mSource;
+    /// Hashed view of mSource
+    ConfigOverrides mApplied;
+    int mFd = -1;
+};
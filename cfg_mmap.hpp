@@ -0,0 +1,332 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "cfg_template.hpp"
+
+/**
+   On-disk layout of a resolved config snapshot.
+
+   The file is a header, one fixed-size entry per enum slot, and a string
+   table holding the keys and the string form of every value.  All integers
+   are in host byte order; a snapshot is meant to be shared by processes on
+   the same host, not shipped between architectures.
+
+   The header carries a fingerprint of the config's schema, so a reader
+   built with a different set of keys or kinds in its enum rejects the file
+   instead of reading values from the wrong slots.
+*/
+namespace cfg_snapshot_format {
+
+constexpr char kMagic[8] = { 'C', 'F', 'G', 'S', 'N', 'A', 'P', '\0' };
+constexpr uint32_t kVersion = 2;
+
+struct Header {
+    char magic[8];
+    uint32_t version;
+    /// Number of entries, which is the enum's slot count
+    uint32_t count;
+    /// Total size of the file, used to bounds check the string table
+    uint64_t fileSize;
+    /// Offset of the string table from the start of the file
+    uint64_t stringsOffset;
+    /// Schema fingerprint of the config, see configSchema()
+    uint64_t schema;
+};
+
+struct Entry {
+    /// 0 if the slot is not registered in the config
+    uint8_t present;
+    /// CVKind of the value
+    uint8_t kind;
+    /// 1 if intVal holds the value's integer form
+    uint8_t hasInt;
+    uint8_t boolVal;
+    uint32_t pad;
+    int64_t intVal;
+    /// Offsets are relative to the string table
+    uint32_t keyOffset;
+    uint32_t keyLength;
+    uint32_t strOffset;
+    uint32_t strLength;
+};
+
+static_assert(sizeof(Header) == 40, "Unexpected snapshot header size");
+static_assert(sizeof(Entry) == 32, "Unexpected snapshot entry size");
+
+constexpr uint64_t kSchemaSeed = 14695981039346656037ULL;
+
+/// Fold one enum slot into an FNV-1a schema fingerprint: its key and kind,
+/// or a marker if the slot is not registered
+constexpr uint64_t hashSlot(uint64_t h, bool present, std::string_view key, CVKind kind)
+{
+    auto mix = [&h](unsigned char c) {
+        h ^= c;
+        h *= 1099511628211ULL;
+    };
+    if (!present) {
+        mix(0xff);
+        return h;
+    }
+    for (char c : key) {
+        mix(static_cast<unsigned char>(c));
+    }
+    mix(0);
+    mix(static_cast<unsigned char>(kind));
+    return h;
+}
+
+} // namespace cfg_snapshot_format
+
+/// Return the schema fingerprint of a config: a hash of the key and CVKind
+/// of each slot, in enum order.  Configs whose snapshots can be read by one
+/// another have the same fingerprint.
+template <typename TConfigEnum>
+uint64_t configSchema(const ConfigTemplate<TConfigEnum>& cfg)
+{
+    uint64_t h = cfg_snapshot_format::kSchemaSeed;
+    for (std::size_t i = 0; i < ConfigEnumCount<TConfigEnum>::value; ++i) {
+        const AbstractCV* val = cfg.find(static_cast<TConfigEnum>(i));
+        h = cfg_snapshot_format::hashSlot(h, val != nullptr, val ? val->key() : std::string_view(),
+                                          val ? val->kind() : CVKind::Str);
+    }
+    return h;
+}
+
+/// Return the schema fingerprint of an enum with a ConfigRegistry, at
+/// compile time.  Matches configSchema() of any config of the enum.
+template <typename TConfigEnum>
+constexpr uint64_t registrySchema()
+{
+    const auto& parms = ConfigRegistry<TConfigEnum>::parms;
+    constexpr std::size_t kNone = std::size(ConfigRegistry<TConfigEnum>::parms);
+    uint64_t h = cfg_snapshot_format::kSchemaSeed;
+    for (std::size_t i = 0; i < ConfigEnumCount<TConfigEnum>::value; ++i) {
+        std::size_t found = kNone;
+        for (std::size_t d = 0; d < kNone; ++d) {
+            if (enumIndex(parms[d].parm) == i) {
+                found = d;
+            }
+        }
+        h = cfg_snapshot_format::hashSlot(h, found != kNone, found != kNone ? parms[found].key : std::string_view(),
+                                          found != kNone ? parms[found].kind : CVKind::Str);
+    }
+    return h;
+}
+
+/// Write a fully resolved config to a binary snapshot file.
+///
+/// The file is written next to path and renamed into place, so processes
+/// mapping the old file keep a consistent view.  Throws std::runtime_error if
+/// the file can't be written.
+/// @param[in] cfg Config to serialize
+/// @param[in] path Snapshot file to create or replace
+template <typename TConfigEnum>
+void writeConfigSnapshot(const ConfigTemplate<TConfigEnum>& cfg, const std::string& path)
+{
+    namespace fmt = cfg_snapshot_format;
+    constexpr std::size_t kCount = ConfigEnumCount<TConfigEnum>::value;
+
+    std::vector<fmt::Entry> entries(kCount);
+    std::string strings;
+    auto intern = [&strings](std::string_view s, uint32_t& off, uint32_t& len) {
+        off = static_cast<uint32_t>(strings.size());
+        len = static_cast<uint32_t>(s.size());
+        strings.append(s);
+    };
+    for (std::size_t i = 0; i < kCount; ++i) {
+        const AbstractCV* val = cfg.find(static_cast<TConfigEnum>(i));
+        fmt::Entry& e = entries[i];
+        std::memset(&e, 0, sizeof(e));
+        if (val == nullptr) {
+            continue;
+        }
+        CVStrBuf scratch;
+        e.present = 1;
+        e.kind = static_cast<uint8_t>(val->kind());
+        e.hasInt = val->hasInt() ? 1 : 0;
+        e.intVal = e.hasInt ? val->asInt() : 0;
+        e.boolVal = val->asBool() ? 1 : 0;
+        intern(val->key(), e.keyOffset, e.keyLength);
+        intern(val->asStrView(scratch), e.strOffset, e.strLength);
+    }
+
+    fmt::Header hdr;
+    std::memcpy(hdr.magic, fmt::kMagic, sizeof(hdr.magic));
+    hdr.version = fmt::kVersion;
+    hdr.count = static_cast<uint32_t>(kCount);
+    hdr.stringsOffset = sizeof(hdr) + entries.size() * sizeof(fmt::Entry);
+    hdr.fileSize = hdr.stringsOffset + strings.size();
+    hdr.schema = configSchema(cfg);
+
+    std::string tmpPath = path + ".tmp";
+    {
+        std::ofstream out(tmpPath, std::ios::binary | std::ios::trunc);
+        out.write(reinterpret_cast<const char*>(&hdr), sizeof(hdr));
+        out.write(reinterpret_cast<const char*>(entries.data()), entries.size() * sizeof(fmt::Entry));
+        out.write(strings.data(), strings.size());
+        if (!out.flush()) {
+            throw std::runtime_error("Failed to write config snapshot: " + tmpPath);
+        }
+    }
+    if (std::rename(tmpPath.c_str(), path.c_str()) != 0) {
+        std::remove(tmpPath.c_str());
+        throw std::runtime_error("Failed to install config snapshot: " + path);
+    }
+}
+
+/**
+   Read-only config served straight from a memory-mapped snapshot file.
+
+   Loading validates the file once and then maps it.  Reads index the entry
+   table directly and string reads return views into the mapping, so nothing
+   is parsed or copied per process.  Many processes mapping the same file
+   share its pages.
+*/
+template <typename TConfigEnum>
+class MappedConfig
+{
+public:
+    /// Constructor for enums with a ConfigRegistry, which know their schema
+    /// at compile time.  See MappedConfig(const std::string&, uint64_t).
+    explicit MappedConfig(const std::string& path)
+        : MappedConfig(path, registrySchema<TConfigEnum>())
+    {
+    }
+
+    /// Constructor
+    /// Throws std::runtime_error if the file is missing, malformed, or was
+    /// written for a config with a different schema.
+    /// @param[in] path Snapshot file written by writeConfigSnapshot()
+    /// @param[in] schema Expected schema fingerprint, e.g. configSchema() of
+    ///            a config built by this process
+    MappedConfig(const std::string& path, uint64_t schema)
+    {
+        int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0) {
+            throw std::runtime_error("Cannot open config snapshot: " + path);
+        }
+        struct stat st;
+        if (::fstat(fd, &st) != 0 || st.st_size < static_cast<off_t>(sizeof(Header))) {
+            ::close(fd);
+            throw std::runtime_error("Config snapshot is truncated: " + path);
+        }
+        mSize = static_cast<std::size_t>(st.st_size);
+        void* base = ::mmap(nullptr, mSize, PROT_READ, MAP_SHARED, fd, 0);
+        ::close(fd);
+        if (base == MAP_FAILED) {
+            throw std::runtime_error("Cannot map config snapshot: " + path);
+        }
+        mBase = static_cast<const char*>(base);
+        try {
+            validate(path, schema);
+        } catch (...) {
+            ::munmap(const_cast<char*>(mBase), mSize);
+            throw;
+        }
+    }
+
+    MappedConfig(const MappedConfig&) = delete;
+    MappedConfig& operator=(const MappedConfig&) = delete;
+
+    ~MappedConfig() { ::munmap(const_cast<char*>(mBase), mSize); }
+
+    /// Get a config value as a specific type
+    /// Throws std::out_of_range if the parm was not in the snapshot.
+    /// @tparam T The type to get the value as.
+    /// @param[in] parm Config parm to lookup
+    template <typename T>
+    T as_(TConfigEnum parm) const {
+        const Entry& e = entry(parm);
+        if constexpr (std::is_same<T, std::string>::value) {
+            return std::string(str(e.strOffset, e.strLength));
+        } else if constexpr (std::is_same<T, std::string_view>::value) {
+            return str(e.strOffset, e.strLength);
+        } else if constexpr (std::is_same<T, bool>::value) {
+            return e.boolVal != 0;
+        } else {
+            if (!e.hasInt) {
+                throw std::invalid_argument("Config value is not an integer: " + std::string(key(parm)));
+            }
+            return static_cast<T>(e.intVal);
+        }
+    }
+
+    /// Get a config value as a specific type without throwing for unknown parms.
+    /// @return false if the parm was not in the snapshot
+    template <typename T>
+    bool tryAs_(TConfigEnum parm, T& returnVal) const {
+        if (!contains(parm)) {
+            return false;
+        }
+        returnVal = as_<T>(parm);
+        return true;
+    }
+
+    /// Return true if the parm was registered when the snapshot was written
+    bool contains(TConfigEnum parm) const noexcept {
+        return enumIndex(parm) < kCount && entries()[enumIndex(parm)].present;
+    }
+
+    /// Return the string name of a config parm
+    std::string_view key(TConfigEnum parm) const {
+        const Entry& e = entry(parm);
+        return str(e.keyOffset, e.keyLength);
+    }
+
+    /// Return the storage kind the value had when the snapshot was written
+    CVKind kind(TConfigEnum parm) const { return static_cast<CVKind>(entry(parm).kind); }
+
+private:
+    using Header = cfg_snapshot_format::Header;
+    using Entry = cfg_snapshot_format::Entry;
+
+    static constexpr std::size_t kCount = ConfigEnumCount<TConfigEnum>::value;
+
+    const Header& header() const { return *reinterpret_cast<const Header*>(mBase); }
+    const Entry* entries() const { return reinterpret_cast<const Entry*>(mBase + sizeof(Header)); }
+
+    const Entry& entry(TConfigEnum parm) const {
+        if (!contains(parm)) {
+            throw std::out_of_range("Unknown config parm: " + std::to_string(enumIndex(parm)));
+        }
+        return entries()[enumIndex(parm)];
+    }
+
+    std::string_view str(uint32_t offset, uint32_t length) const {
+        return std::string_view(mBase + header().stringsOffset + offset, length);
+    }
+
+    /// Check the header and that every string lies inside the file
+    void validate(const std::string& path, uint64_t schema) const {
+        const Header& hdr = header();
+        if (std::memcmp(hdr.magic, cfg_snapshot_format::kMagic, sizeof(hdr.magic)) != 0
+            || hdr.version != cfg_snapshot_format::kVersion) {
+            throw std::runtime_error("Not a supported config snapshot: " + path);
+        }
+        if (hdr.count != kCount || hdr.schema != schema || hdr.fileSize != mSize
+            || hdr.stringsOffset != sizeof(Header) + kCount * sizeof(Entry) || hdr.stringsOffset > mSize) {
+            throw std::runtime_error("Config snapshot does not match this config: " + path);
+        }
+        uint64_t strSize = mSize - hdr.stringsOffset;
+        for (std::size_t i = 0; i < kCount; ++i) {
+            const Entry& e = entries()[i];
+            if (e.present && (uint64_t(e.keyOffset) + e.keyLength > strSize || uint64_t(e.strOffset) + e.strLength > strSize)) {
+                throw std::runtime_error("Config snapshot is corrupt: " + path);
+            }
+        }
+    }
+
+    const char* mBase = nullptr;
+    std::size_t mSize = 0;
+};
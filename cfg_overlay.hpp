@@ -0,0 +1,177 @@
+#pragma once
+
+#include <array>
+#include <bitset>
+#include <cassert>
+#include <cstddef>
+#include <memory>
+#include <memory_resource>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include "cfg_template.hpp"
+
+/**
+   Short-lived overlay of a few overrides on a ConfigTemplate.
+
+   Meant to live on the stack for the length of one query, holding the
+   session's SET overrides.  Up to N slots can be overridden, including
+   read-only ones.  Overridden slots are marked in a bitmap and their values
+   kept in a small inline array.  The values are made by rebind() into a
+   buffer inside the overlay, so making and dropping an overlay with N or
+   fewer short values does not touch the heap.  Reads of slots that aren't
+   overridden cost one bit test on top of the base config read.  Overriding
+   a slot again replaces its value, but the old value's bytes are only
+   reclaimed with the overlay.  Each override is checked against the enum's
+   ConfigConstraints, together with the base values, before it is applied.
+
+   The base must outlive the overlay.  An overlay is neither copyable nor
+   movable, and is not safe to change while other threads read it.
+   @tparam N Maximum number of overridden slots
+*/
+template <typename TConfigEnum, std::size_t N = 4>
+class ConfigOverlay
+{
+public:
+    using Config = ConfigTemplate<TConfigEnum>;
+
+    /// Constructor
+    /// @param[in] base Config to fall through to
+    explicit ConfigOverlay(const Config& base) : mBase(base) {}
+
+    ConfigOverlay(const ConfigOverlay&) = delete;
+    ConfigOverlay& operator=(const ConfigOverlay&) = delete;
+
+    /// Get a config value as a specific type
+    /// Throws std::out_of_range if the parm was never registered.
+    /// @tparam T The type to get the value as.
+    /// @param[in] parm Config parm to lookup
+    template <typename T>
+    T as_(TConfigEnum parm) const {
+        T returnVal;
+        if (!tryAs_(parm, returnVal)) {
+            throw std::out_of_range("Unknown config parm: " + std::to_string(enumIndex(parm)));
+        }
+        return returnVal;
+    }
+
+    /// Get a config value as a specific type without throwing for unknown parms.
+    /// @return false if the parm is not registered in the base config
+    template <typename T>
+    bool tryAs_(TConfigEnum parm, T& returnVal) const {
+        const AbstractCV* val = find(parm);
+        if (val == nullptr) {
+            return false;
+        }
+        convertToType(*val, returnVal);
+        return true;
+    }
+
+    /// Get a config value in its storage type.  See ConfigTemplate::get().
+    template <TConfigEnum Parm>
+    typename ConfigParmTraits<TConfigEnum, Parm>::CVType::value_type get() const {
+        using CVType = typename ConfigParmTraits<TConfigEnum, Parm>::CVType;
+        std::size_t idx = enumIndex(Parm);
+        if (!mOverridden[idx]) {
+            return mBase.template get<Parm>();
+        }
+        const AbstractCV* val = mVals[slot(idx)].get();
+        assert(dynamic_cast<const CVType*>(val) != nullptr);
+        return static_cast<const CVType*>(val)->value();
+    }
+
+    /// Get a config value as a string without allocating.
+    /// See ConfigTemplate::asStrView().
+    std::string_view asStrView(TConfigEnum parm, CVStrBuf& scratch) const {
+        const AbstractCV* val = find(parm);
+        if (val == nullptr) {
+            throw std::out_of_range("Unknown config parm: " + std::to_string(enumIndex(parm)));
+        }
+        return val->asStrView(scratch);
+    }
+
+    /// Find the config value for a parm, preferring the overlay's override
+    /// @return The config value or nullptr if the parm is not registered
+    const AbstractCV* find(TConfigEnum parm) const noexcept {
+        std::size_t idx = enumIndex(parm);
+        if (idx < kCount && mOverridden[idx]) {
+            return mVals[slot(idx)].get();
+        }
+        return mBase.find(parm);
+    }
+
+    /// Return true if the overlay overrides the parm
+    bool overridden(TConfigEnum parm) const noexcept {
+        std::size_t idx = enumIndex(parm);
+        return idx < kCount && mOverridden[idx];
+    }
+
+    /// Override a parm for the life of the overlay
+    /// Any registered parm can be overridden, as with constructor overrides.
+    /// Throws std::out_of_range if the parm is not registered,
+    /// std::length_error if N parms are already overridden, the value's parse
+    /// error if the new value is not valid for it, and std::invalid_argument
+    /// if it would break a config constraint.
+    /// @param[in] parm Config parm to override
+    /// @param[in] newVal New value
+    void overrideValue(TConfigEnum parm, std::string_view newVal) {
+        const AbstractCV* base = mBase.find(parm);
+        if (base == nullptr) {
+            throw std::out_of_range("Unknown config parm: " + std::to_string(enumIndex(parm)));
+        }
+        std::size_t idx = enumIndex(parm);
+        if (!mOverridden[idx] && mCount == N) {
+            throw std::length_error("Too many config overrides: " + std::string(base->key()));
+        }
+        std::shared_ptr<AbstractCV> next = base->rebind(newVal, &mArena);
+        Config::checkConstraints(*this, parm, next.get());
+        if (mOverridden[idx]) {
+            mVals[slot(idx)] = std::move(next);
+            return;
+        }
+        mVals[mCount] = std::move(next);
+        mSlots[mCount++] = static_cast<uint32_t>(idx);
+        mOverridden[idx] = true;
+    }
+
+    /// Override a parm by its string key
+    /// Throws std::out_of_range if the key is not a known config key.
+    void overrideValue(std::string_view key, std::string_view newVal) {
+        TConfigEnum parm;
+        if (!mBase.parmForKey(key, parm)) {
+            throw std::out_of_range("Unknown config key: " + std::string(key));
+        }
+        overrideValue(parm, newVal);
+    }
+
+    /// Return the base config
+    const Config& base() const { return mBase; }
+
+private:
+    static constexpr std::size_t kCount = ConfigEnumCount<TConfigEnum>::value;
+    /// Inline bytes per override.  Fits any config value and its control
+    /// block, plus a short string.
+    static constexpr std::size_t kBytesPerValue = 192;
+
+    /// Return the position of an overridden slot in mVals
+    std::size_t slot(std::size_t idx) const noexcept {
+        std::size_t i = 0;
+        while (mSlots[i] != idx) {
+            ++i;
+        }
+        return i;
+    }
+
+    const Config& mBase;
+    /// Slots that have an entry in mVals
+    std::bitset<kCount> mOverridden;
+    std::size_t mCount = 0;
+    /// Slot of each override, in the order they were added
+    std::array<uint32_t, N> mSlots{};
+    /// Storage for overridden values.  Falls back to the default resource
+    /// once full.
+    alignas(std::max_align_t) std::byte mBuffer[N * kBytesPerValue];
+    std::pmr::monotonic_buffer_resource mArena{mBuffer, sizeof(mBuffer), std::pmr::get_default_resource()};
+    /// Overridden values.  Declared after mArena so they are freed first.
+    std::array<std::shared_ptr<AbstractCV>, N> mVals;
+};
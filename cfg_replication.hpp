@@ -0,0 +1,316 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+#include "cfg_template.hpp"
+
+/**
+   Wire format of a config delta.
+
+   A delta is a header followed by one record per changed parm: its enum
+   index, the length of its value and the value's string form.  Integers are
+   little-endian regardless of host, since deltas travel between nodes.
+
+       magic[4] "CFGD" | u8 format | u8 flags | u16 count | u64 source | u64 seq
+       { u16 index | u32 length | value[length] } * count
+*/
+namespace cfg_delta_format {
+
+constexpr char kMagic[4] = { 'C', 'F', 'G', 'D' };
+constexpr uint8_t kVersion = 1;
+/// Header flag: the delta holds every updatable parm, not just changes
+constexpr uint8_t kFull = 1;
+constexpr std::size_t kHeaderSize = 24;
+
+inline void putLE(std::string& out, uint64_t v, std::size_t bytes)
+{
+    for (std::size_t i = 0; i < bytes; ++i) {
+        out.push_back(static_cast<char>(v >> (8 * i)));
+    }
+}
+
+inline uint64_t getLE(const char* in, std::size_t bytes)
+{
+    uint64_t v = 0;
+    for (std::size_t i = 0; i < bytes; ++i) {
+        v |= uint64_t(static_cast<unsigned char>(in[i])) << (8 * i);
+    }
+    return v;
+}
+
+} // namespace cfg_delta_format
+
+/// Decoded config delta
+template <typename TConfigEnum>
+struct ConfigDelta {
+    /// Identifies the replicator that produced the delta.  Sequence numbers
+    /// are only comparable between deltas from the same source.
+    uint64_t source = 0;
+    /// Position of the delta in its source's stream, starting at 1
+    uint64_t seq = 0;
+    /// True if the delta holds every updatable parm, so it can be applied
+    /// without the deltas before it
+    bool full = false;
+    std::vector<std::pair<TConfigEnum, std::string>> updates;
+};
+
+/// Encode a delta for sending to other nodes
+template <typename TConfigEnum>
+std::string encodeConfigDelta(const ConfigDelta<TConfigEnum>& delta)
+{
+    namespace fmt = cfg_delta_format;
+    std::string out(fmt::kMagic, sizeof(fmt::kMagic));
+    out.push_back(static_cast<char>(fmt::kVersion));
+    out.push_back(static_cast<char>(delta.full ? fmt::kFull : 0));
+    fmt::putLE(out, delta.updates.size(), 2);
+    fmt::putLE(out, delta.source, 8);
+    fmt::putLE(out, delta.seq, 8);
+    for (auto& u : delta.updates) {
+        fmt::putLE(out, enumIndex(u.first), 2);
+        fmt::putLE(out, u.second.size(), 4);
+        out.append(u.second);
+    }
+    return out;
+}
+
+/// Decode a delta received from another node
+/// @return false if the bytes are not a well-formed delta for this config enum
+template <typename TConfigEnum>
+bool decodeConfigDelta(std::string_view in, ConfigDelta<TConfigEnum>& delta)
+{
+    namespace fmt = cfg_delta_format;
+    if (in.size() < fmt::kHeaderSize || in.compare(0, sizeof(fmt::kMagic), fmt::kMagic, sizeof(fmt::kMagic)) != 0
+        || static_cast<uint8_t>(in[4]) != fmt::kVersion) {
+        return false;
+    }
+    delta.full = (static_cast<uint8_t>(in[5]) & fmt::kFull) != 0;
+    std::size_t count = fmt::getLE(in.data() + 6, 2);
+    delta.source = fmt::getLE(in.data() + 8, 8);
+    delta.seq = fmt::getLE(in.data() + 16, 8);
+    delta.updates.clear();
+    delta.updates.reserve(count);
+    std::size_t pos = fmt::kHeaderSize;
+    for (std::size_t i = 0; i < count; ++i) {
+        if (in.size() - pos < 6) {
+            return false;
+        }
+        std::size_t idx = fmt::getLE(in.data() + pos, 2);
+        std::size_t len = fmt::getLE(in.data() + pos + 2, 4);
+        pos += 6;
+        if (idx >= ConfigEnumCount<TConfigEnum>::value || in.size() - pos < len) {
+            return false;
+        }
+        delta.updates.emplace_back(static_cast<TConfigEnum>(idx), std::string(in.substr(pos, len)));
+        pos += len;
+    }
+    return pos == in.size();
+}
+
+/**
+   Ships the changes to a config's updatable parms to other nodes.
+
+   The replicator subscribes to the config, so a burst of set() calls that
+   lands before the notification dispatch runs goes out as one delta holding
+   each changed parm once, with its latest value.  Each delta is encoded once
+   and handed to the sender, which fans it out to the other nodes; the sender
+   runs on the config's notification executor, never on the thread that
+   called set().
+
+   Replication is one way: run a replicator on the node that takes config
+   changes and a ConfigDeltaApplier on every other node.  Followers that
+   miss a delta, or join late, catch up by applying snapshot().
+*/
+template <typename TConfigEnum>
+class ConfigReplicator
+{
+public:
+    using Config = ConfigTemplate<TConfigEnum>;
+    /// Sends an encoded delta to the other nodes
+    using Sender = std::function<void(std::string_view delta)>;
+
+    /// Constructor
+    /// @param[in] cfg Config to replicate.  Must outlive the replicator.
+    /// @param[in] send Called with each encoded delta
+    ConfigReplicator(Config& cfg, Sender send)
+        : mState(std::make_shared<State>(cfg, std::move(send)))
+    {
+        std::vector<TConfigEnum> parms;
+        for (std::size_t i = 0; i < kCount; ++i) {
+            const AbstractCV* val = cfg.find(static_cast<TConfigEnum>(i));
+            if (val != nullptr && val->updatable()) {
+                parms.push_back(static_cast<TConfigEnum>(i));
+            }
+        }
+        std::weak_ptr<State> weak = mState;
+        mSubId = cfg.subscribe(parms, [weak](const std::vector<TConfigEnum>& changed) {
+            if (auto state = weak.lock()) {
+                state->sendDelta(changed);
+            }
+        });
+    }
+
+    ConfigReplicator(const ConfigReplicator&) = delete;
+    ConfigReplicator& operator=(const ConfigReplicator&) = delete;
+
+    /// Destructor.  A dispatch already running may still send one delta.
+    ~ConfigReplicator() { mState->mCfg.unsubscribe(mSubId); }
+
+    /// Encode every updatable parm as a full delta at the current sequence
+    /// number, for a node that is joining or has fallen behind
+    std::string snapshot() const {
+        std::lock_guard<std::mutex> lock(mState->mMutex);
+        std::vector<TConfigEnum> parms;
+        for (std::size_t i = 0; i < kCount; ++i) {
+            const AbstractCV* val = mState->mCfg.find(static_cast<TConfigEnum>(i));
+            if (val != nullptr && val->updatable()) {
+                parms.push_back(static_cast<TConfigEnum>(i));
+            }
+        }
+        return mState->encode(parms, mState->mSeq, true);
+    }
+
+    /// Return the sequence number of the last delta sent
+    uint64_t sequence() const {
+        std::lock_guard<std::mutex> lock(mState->mMutex);
+        return mState->mSeq;
+    }
+
+private:
+    static constexpr std::size_t kCount = ConfigEnumCount<TConfigEnum>::value;
+
+    /// Shared with the subscription, which may outlive the replicator
+    struct State {
+        State(Config& cfg, Sender send)
+            : mCfg(cfg), mSend(std::move(send))
+            , mSource(static_cast<uint64_t>(std::chrono::system_clock::now().time_since_epoch().count())
+                      ^ reinterpret_cast<uintptr_t>(this))
+        {
+        }
+
+        /// Sends under the lock so deltas go out in sequence order
+        void sendDelta(const std::vector<TConfigEnum>& changed) {
+            std::lock_guard<std::mutex> lock(mMutex);
+            mSend(encode(changed, ++mSeq, false));
+        }
+
+        /// Encode the current values of some parms.  The values are read
+        /// between two matching, even config versions so they are from one
+        /// point in time.
+        std::string encode(const std::vector<TConfigEnum>& parms, uint64_t seq, bool full) const {
+            ConfigDelta<TConfigEnum> delta{ mSource, seq, full, {} };
+            delta.updates.reserve(parms.size());
+            mCfg.readConsistent([&] {
+                delta.updates.clear();
+                for (TConfigEnum parm : parms) {
+                    delta.updates.emplace_back(parm, mCfg.template as_<std::string>(parm));
+                }
+            });
+            return encodeConfigDelta(delta);
+        }
+
+        Config& mCfg;
+        Sender mSend;
+        const uint64_t mSource;
+        mutable std::mutex mMutex;
+        /// Sequence number of the last delta sent
+        uint64_t mSeq = 0;
+    };
+
+    std::shared_ptr<State> mState;
+    uint64_t mSubId = 0;
+};
+
+/// Outcome of applying a delta
+enum class DeltaStatus : uint8_t {
+    Applied,
+    /// Already applied, or older than what was applied.  Nothing changed.
+    Stale,
+    /// Deltas before this one are missing, or it is from a new source.
+    /// Nothing changed; apply a snapshot to catch up.
+    Gap,
+    /// Not a well-formed delta for this config
+    Malformed,
+    /// setMany() rejected the update.  Nothing changed.
+    Rejected,
+};
+
+/// Return a description of a DeltaStatus
+inline const char* deltaStatusStr(DeltaStatus status)
+{
+    switch (status) {
+    case DeltaStatus::Applied: return "applied";
+    case DeltaStatus::Stale: return "stale delta";
+    case DeltaStatus::Gap: return "missing earlier deltas";
+    case DeltaStatus::Malformed: return "malformed delta";
+    case DeltaStatus::Rejected: return "delta rejected by config";
+    }
+    return "unknown status";
+}
+
+/**
+   Applies deltas from a ConfigReplicator to a follower's config.
+
+   Each delta goes through setMany(), so it is applied all at once or not at
+   all.  The applier tracks the source and sequence number it last applied;
+   repeated and out-of-date deltas are skipped without touching the config,
+   and a missing delta is reported so the caller can fetch a snapshot.  A new
+   applier starts with a snapshot.
+*/
+template <typename TConfigEnum>
+class ConfigDeltaApplier
+{
+public:
+    using Config = ConfigTemplate<TConfigEnum>;
+
+    /// Constructor
+    /// @param[in] cfg Config to apply deltas to.  Must outlive the applier.
+    explicit ConfigDeltaApplier(Config& cfg) : mCfg(cfg) {}
+
+    /// Apply one encoded delta
+    DeltaStatus apply(std::string_view bytes) {
+        ConfigDelta<TConfigEnum> delta;
+        if (!decodeConfigDelta(bytes, delta)) {
+            return DeltaStatus::Malformed;
+        }
+        std::lock_guard<std::mutex> lock(mMutex);
+        bool sameSource = mApplied && delta.source == mSource;
+        // A snapshot at the applied sequence may still carry newer values
+        if (sameSource && (delta.full ? delta.seq < mSeq : delta.seq <= mSeq)) {
+            return DeltaStatus::Stale;
+        }
+        if (!delta.full && (!sameSource || delta.seq != mSeq + 1)) {
+            return DeltaStatus::Gap;
+        }
+        auto results = mCfg.setMany(delta.updates);
+        for (SetError err : results) {
+            if (err != SetError::None) {
+                return DeltaStatus::Rejected;
+            }
+        }
+        mApplied = true;
+        mSource = delta.source;
+        mSeq = delta.seq;
+        return DeltaStatus::Applied;
+    }
+
+    /// Return the sequence number of the last delta applied, or 0 if none
+    uint64_t appliedSequence() const {
+        std::lock_guard<std::mutex> lock(mMutex);
+        return mSeq;
+    }
+
+private:
+    Config& mCfg;
+    mutable std::mutex mMutex;
+    /// False until the first delta, which must be a snapshot, is applied
+    bool mApplied = false;
+    uint64_t mSource = 0;
+    uint64_t mSeq = 0;
+};
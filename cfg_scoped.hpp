@@ -0,0 +1,259 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bitset>
+#include <map>
+#include <memory>
+#include <memory_resource>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+#include "cfg_template.hpp"
+
+/**
+   Config scope in a hierarchy such as global -> node -> session.
+
+   The root scope wraps a ConfigTemplate.  Each child scope inherits from its
+   parent and only owns the values it overrides (its deltas).  Every scope
+   keeps a flattened table with the resolved value for each parm, so a read is
+   one indexed load no matter how deep the scope is.
+
+   Changing a value in a scope updates that one slot in the scope and in the
+   descendants that don't override it, rather than rebuilding the tree.
+   Scope changes are serialized by a mutex shared by the whole tree; reads are
+   lock-free.  Values replaced while the tree is live are retired rather than
+   freed, so a reader never sees a dangling value.  A parent must outlive its
+   children.
+
+   The resolved values of each scope are checked against the enum's
+   ConfigConstraints when the scope is built, and a change is checked in the
+   scope and every descendant that inherits it before it is applied.
+*/
+template <typename TConfigEnum>
+class ScopedConfig
+{
+public:
+    using Config = ConfigTemplate<TConfigEnum>;
+
+    /// Construct a root scope
+    /// @param[in] root Config that holds the defaults for the whole tree
+    explicit ScopedConfig(std::shared_ptr<const Config> root)
+        : mRoot(std::move(root)), mMutex(std::make_shared<std::mutex>())
+    {
+        for (std::size_t i = 0; i < kCount; ++i) {
+            mResolved[i].store(mRoot->find(static_cast<TConfigEnum>(i)), std::memory_order_relaxed);
+        }
+    }
+
+    /// Construct a child scope
+    /// Throws std::out_of_range if a delta key is not a known config key, and
+    /// std::invalid_argument if the deltas break a config constraint.
+    /// @param[in] parent Scope to inherit from
+    /// @param[in] deltas List of key/value pairs this scope overrides
+    ScopedConfig(ScopedConfig& parent, const std::map<std::string, std::string>& deltas = {})
+        : mRoot(parent.mRoot), mMutex(parent.mMutex), mParent(&parent)
+    {
+        std::lock_guard<std::mutex> lock(*mMutex);
+        for (std::size_t i = 0; i < kCount; ++i) {
+            mResolved[i].store(parent.mResolved[i].load(std::memory_order_relaxed), std::memory_order_relaxed);
+        }
+        for (auto& d : deltas) {
+            TConfigEnum parm;
+            if (!mRoot->parmForKey(d.first, parm)) {
+                throw std::out_of_range("Unknown config key: " + d.first);
+            }
+            putDelta(enumIndex(parm), mRoot->find(parm)->rebind(d.second, mRoot->resource()));
+        }
+        Config::checkConstraints(*this);
+        parent.mChildren.push_back(this);
+    }
+
+    ScopedConfig(const ScopedConfig&) = delete;
+    ScopedConfig& operator=(const ScopedConfig&) = delete;
+
+    ~ScopedConfig()
+    {
+        if (mParent != nullptr) {
+            std::lock_guard<std::mutex> lock(*mMutex);
+            auto& siblings = mParent->mChildren;
+            siblings.erase(std::remove(siblings.begin(), siblings.end(), this), siblings.end());
+        }
+    }
+
+    /// Get a config value as a specific type
+    /// Throws std::out_of_range if the parm was never registered.
+    /// @tparam T The type to get the value as.
+    /// @param[in] parm Config parm to lookup
+    template <typename T>
+    T as_(TConfigEnum parm) const {
+        T returnVal;
+        if (!tryAs_(parm, returnVal)) {
+            throw std::out_of_range("Unknown config parm: " + std::to_string(enumIndex(parm)));
+        }
+        return returnVal;
+    }
+
+    /// Get a config value as a specific type without throwing for unknown parms.
+    /// @return false if the parm is not registered in the root config
+    template <typename T>
+    bool tryAs_(TConfigEnum parm, T& returnVal) const {
+        const AbstractCV* val = find(parm);
+        if (val == nullptr) {
+            return false;
+        }
+        convertToType(*val, returnVal);
+        return true;
+    }
+
+    /// Find the resolved config value for a parm
+    /// @return The config value or nullptr if the parm is not registered
+    const AbstractCV* find(TConfigEnum parm) const noexcept {
+        std::size_t idx = enumIndex(parm);
+        return idx < kCount ? mResolved[idx].load(std::memory_order_acquire) : nullptr;
+    }
+
+    /// Override a parm in this scope and in the children that inherit it
+    /// Any parm can be overridden, as with constructor overrides.
+    /// Throws std::out_of_range if the parm is not registered, and
+    /// std::invalid_argument if the value would break a config constraint.
+    /// @param[in] parm Config parm to override
+    /// @param[in] newVal New value for this scope
+    void overrideValue(TConfigEnum parm, const std::string& newVal) {
+        std::lock_guard<std::mutex> lock(*mMutex);
+        std::shared_ptr<AbstractCV> next = rootValue(parm).rebind(newVal, mRoot->resource());
+        checkChange(parm, next.get());
+        putDelta(enumIndex(parm), std::move(next));
+    }
+
+    /// Drop this scope's override of a parm so it inherits from the parent again
+    /// Throws std::invalid_argument if the inherited value would break a
+    /// config constraint, and keeps the override.
+    /// @param[in] parm Config parm to stop overriding
+    void clearOverride(TConfigEnum parm) {
+        std::lock_guard<std::mutex> lock(*mMutex);
+        std::size_t idx = enumIndex(parm);
+        if (idx >= kCount || !mOverridden[idx]) {
+            return;
+        }
+        const AbstractCV* inherited = (mParent != nullptr) ? mParent->mResolved[idx].load() : mRoot->find(parm);
+        checkChange(parm, inherited);
+        auto it = delta(idx);
+        mRetired.push_back(std::move(it->second));
+        mDeltas.erase(it);
+        mOverridden[idx] = false;
+        propagate(idx, inherited);
+    }
+
+    /// Set an updatable config value in this scope
+    /// The first set() of an inherited value copies it into this scope.
+    /// Throws for unknown or read-only parms, like ConfigTemplate::set(), and
+    /// std::invalid_argument if the value would break a config constraint.
+    /// @param[in] parm Config parm to set
+    /// @param[in] newVal New value to set.
+    void set(TConfigEnum parm, const std::string& newVal) {
+        std::lock_guard<std::mutex> lock(*mMutex);
+        const AbstractCV& val = rootValue(parm);
+        if (!val.updatable()) {
+            throw std::runtime_error("Read-only config value.  Set is not supported: " + std::string(val.key()));
+        }
+        std::size_t idx = enumIndex(parm);
+        if (mOverridden[idx]) {
+            if constexpr (Config::kHasConstraints) {
+                // Only checked, so the copy doesn't come out of the root's resource
+                checkChange(parm, val.rebind(newVal, std::pmr::get_default_resource()).get());
+            }
+            delta(idx)->second->set(newVal);
+        } else {
+            std::shared_ptr<AbstractCV> next = val.rebind(newVal, mRoot->resource());
+            checkChange(parm, next.get());
+            putDelta(idx, std::move(next));
+        }
+    }
+
+    /// Return true if this scope overrides the parm
+    bool overridden(TConfigEnum parm) const {
+        std::lock_guard<std::mutex> lock(*mMutex);
+        std::size_t idx = enumIndex(parm);
+        return idx < kCount && mOverridden[idx];
+    }
+
+    /// Return the parent scope, or nullptr for the root scope
+    const ScopedConfig* parent() const { return mParent; }
+
+private:
+    static constexpr std::size_t kCount = ConfigEnumCount<TConfigEnum>::value;
+
+    using Delta = std::pair<std::size_t, std::shared_ptr<AbstractCV>>;
+
+    /// Return the root's value for a parm or throw if it is not registered
+    const AbstractCV& rootValue(TConfigEnum parm) const {
+        const AbstractCV* val = mRoot->find(parm);
+        if (val == nullptr) {
+            throw std::out_of_range("Unknown config parm: " + std::to_string(enumIndex(parm)));
+        }
+        return *val;
+    }
+
+    /// Return the delta for a slot, or the position it would be inserted at
+    typename std::vector<Delta>::iterator delta(std::size_t idx) {
+        return std::lower_bound(mDeltas.begin(), mDeltas.end(), idx,
+                                [](const Delta& d, std::size_t i) { return d.first < i; });
+    }
+
+    /// Install a delta for a slot and push it down the tree.  Caller holds mMutex.
+    void putDelta(std::size_t idx, std::shared_ptr<AbstractCV> val) {
+        const AbstractCV* raw = val.get();
+        auto it = delta(idx);
+        if (mOverridden[idx]) {
+            mRetired.push_back(std::move(it->second));
+            it->second = std::move(val);
+        } else {
+            mDeltas.emplace(it, idx, std::move(val));
+            mOverridden[idx] = true;
+        }
+        propagate(idx, raw);
+    }
+
+    /// Check the config constraints with a parm resolved to a new value here
+    /// and in every descendant that inherits it.  Caller holds mMutex.
+    void checkChange(TConfigEnum parm, const AbstractCV* val) const {
+        if constexpr (Config::kHasConstraints) {
+            Config::checkConstraints(*this, parm, val);
+            for (const ScopedConfig* child : mChildren) {
+                if (!child->mOverridden[enumIndex(parm)]) {
+                    child->checkChange(parm, val);
+                }
+            }
+        }
+    }
+
+    /// Resolve a slot to a new value here and in every descendant that
+    /// inherits it.  Caller holds mMutex.
+    void propagate(std::size_t idx, const AbstractCV* val) {
+        mResolved[idx].store(val, std::memory_order_release);
+        for (ScopedConfig* child : mChildren) {
+            if (!child->mOverridden[idx]) {
+                child->propagate(idx, val);
+            }
+        }
+    }
+
+    std::shared_ptr<const Config> mRoot;
+    /// Serializes changes anywhere in the tree
+    std::shared_ptr<std::mutex> mMutex;
+    ScopedConfig* mParent = nullptr;
+    std::vector<ScopedConfig*> mChildren;
+    /// Resolved value of every slot
+    std::array<std::atomic<const AbstractCV*>, kCount> mResolved;
+    /// Slots that have an entry in mDeltas
+    std::bitset<kCount> mOverridden;
+    /// Values this scope overrides, sorted by slot
+    std::vector<Delta> mDeltas;
+    /// Replaced deltas, kept until the scope goes away in case a reader still
+    /// holds them
+    std::vector<std::shared_ptr<AbstractCV>> mRetired;
+};
@@ -0,0 +1,516 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "cfg_mmap.hpp"
+#include "cfg_template.hpp"
+
+/**
+   Layout of a config in a POSIX shared-memory segment.
+
+   The segment is a header, one entry per enum slot, and a key table.  Each
+   entry is followed by an inline string buffer of Header::strCapacity bytes.
+   Keys and kinds are written once, by the publisher, before the segment is
+   marked ready.  Values are atomics guarded by the header's sequence count:
+   the publisher makes it odd while it writes and even again when done, and
+   readers retry a read that overlapped a write.
+
+   The header carries the config's schema fingerprint, as snapshot files do,
+   so a reader whose enum has other keys or kinds rejects the segment.
+
+   All integers are in host byte order and all atomics must be address-free,
+   since processes map the segment at different addresses.
+*/
+namespace cfg_shm_format {
+
+constexpr char kMagic[8] = { 'C', 'F', 'G', 'S', 'H', 'M', '\0', '\0' };
+constexpr uint32_t kVersion = 2;
+
+static_assert(std::atomic<uint64_t>::is_always_lock_free, "Shared config needs lock-free 64-bit atomics");
+static_assert(std::atomic<uint32_t>::is_always_lock_free, "Shared config needs lock-free 32-bit atomics");
+
+struct Header {
+    char magic[8];
+    uint32_t version;
+    /// Number of entries, which is the enum's slot count
+    uint32_t count;
+    /// Total size of the segment
+    uint64_t size;
+    /// Schema fingerprint of the config, see configSchema()
+    uint64_t schema;
+    /// Bytes of string storage after each entry, a multiple of 8
+    uint32_t strCapacity;
+    /// Offset of the key table from the start of the segment
+    uint32_t keysOffset;
+    /// Set to 1 once the segment is fully written
+    std::atomic<uint32_t> ready;
+    uint32_t pad;
+    /// Even while the values are stable, odd while the publisher writes
+    alignas(kCacheLineSize) std::atomic<uint64_t> seq;
+};
+
+struct Entry {
+    /// 0 if the slot is not registered in the config
+    uint8_t present;
+    /// CVKind of the value
+    uint8_t kind;
+    uint8_t updatable;
+    uint8_t pad;
+    /// Offset is relative to the key table
+    uint32_t keyOffset;
+    uint32_t keyLength;
+    /// kHasInt and kBool
+    std::atomic<uint32_t> flags;
+    std::atomic<int64_t> intVal;
+    std::atomic<uint32_t> strLength;
+    uint32_t pad2;
+    // Followed by strCapacity / 8 std::atomic<uint64_t> words of string
+};
+
+constexpr uint32_t kHasInt = 1;
+constexpr uint32_t kBool = 2;
+
+static_assert(sizeof(Entry) % 8 == 0, "Unexpected shared entry size");
+
+/// Distance from one entry to the next
+constexpr std::size_t entryStride(uint32_t strCapacity) { return sizeof(Entry) + strCapacity; }
+
+inline Entry* entryAt(void* base, std::size_t idx, uint32_t strCapacity)
+{
+    return reinterpret_cast<Entry*>(static_cast<char*>(base) + sizeof(Header) + idx * entryStride(strCapacity));
+}
+
+inline std::atomic<uint64_t>* strWords(Entry* e) { return reinterpret_cast<std::atomic<uint64_t>*>(e + 1); }
+
+} // namespace cfg_shm_format
+
+/**
+   Publishes a ConfigTemplate's values into a POSIX shared-memory segment.
+
+   There is one publisher per segment, in the process that owns the config.
+   Updates made through the publisher are applied to the config, which
+   validates them, notifies subscribers and so on, and then written to the
+   segment in one sequence-count update.  Readers in every process see a
+   multi-parm update all at once.  Changes made to the config by other paths
+   become visible after publish().
+
+   The segment is created, or replaced, by the constructor and unlinked by
+   the destructor.  Replacing unlinks the old segment and creates a new one
+   rather than truncating it in place, so processes that still have the old
+   one mapped keep reading its last published values.  The destructor only
+   unlinks the name while it still refers to this publisher's segment, so it
+   never removes one created by a newer publisher.
+*/
+template <typename TConfigEnum>
+class SharedConfigPublisher
+{
+public:
+    using Config = ConfigTemplate<TConfigEnum>;
+
+    /// Smallest strCapacity, enough for the string form of any integer
+    static constexpr uint32_t kMinStrCapacity = 24;
+
+    /// Constructor
+    /// Throws std::invalid_argument if strCapacity is below kMinStrCapacity,
+    /// std::runtime_error if the segment can't be created, and
+    /// std::length_error if a string value doesn't fit in strCapacity.
+    /// @param[in] name Shared memory object name, e.g. "/cluster-config"
+    /// @param[in] cfg Config to publish.  Must outlive the publisher.
+    /// @param[in] strCapacity Longest string form a value can have
+    SharedConfigPublisher(std::string name, Config& cfg, uint32_t strCapacity = 128)
+        : mName(std::move(name)), mCfg(cfg), mCapacity((strCapacity + 7) & ~uint32_t(7))
+    {
+        namespace fmt = cfg_shm_format;
+        if (strCapacity < kMinStrCapacity) {
+            throw std::invalid_argument("Shared config string capacity must be at least "
+                                        + std::to_string(kMinStrCapacity));
+        }
+        std::string keys;
+        for (std::size_t i = 0; i < kCount; ++i) {
+            if (const AbstractCV* val = mCfg.find(static_cast<TConfigEnum>(i))) {
+                keys.append(val->key());
+            }
+        }
+        std::size_t keysOffset = sizeof(fmt::Header) + kCount * fmt::entryStride(mCapacity);
+        mSize = keysOffset + keys.size();
+
+        // Truncating a live segment would pull it out from under readers
+        // that have it mapped, so replace it with a new one instead
+        ::shm_unlink(mName.c_str());
+        int fd = ::shm_open(mName.c_str(), O_CREAT | O_EXCL | O_RDWR | O_CLOEXEC, 0644);
+        if (fd < 0) {
+            throw std::runtime_error("Cannot create shared config: " + mName);
+        }
+        struct stat st;
+        void* base = MAP_FAILED;
+        if (::fstat(fd, &st) == 0 && ::ftruncate(fd, static_cast<off_t>(mSize)) == 0) {
+            mDev = st.st_dev;
+            mIno = st.st_ino;
+            base = ::mmap(nullptr, mSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        }
+        ::close(fd);
+        if (base == MAP_FAILED) {
+            ::shm_unlink(mName.c_str());
+            throw std::runtime_error("Cannot map shared config: " + mName);
+        }
+        mBase = base;
+
+        auto* hdr = new (mBase) fmt::Header;
+        std::memcpy(hdr->magic, fmt::kMagic, sizeof(hdr->magic));
+        hdr->version = fmt::kVersion;
+        hdr->count = static_cast<uint32_t>(kCount);
+        hdr->size = mSize;
+        hdr->schema = configSchema(mCfg);
+        hdr->strCapacity = mCapacity;
+        hdr->keysOffset = static_cast<uint32_t>(keysOffset);
+        hdr->ready.store(0, std::memory_order_relaxed);
+        hdr->seq.store(0, std::memory_order_relaxed);
+        std::memcpy(static_cast<char*>(mBase) + keysOffset, keys.data(), keys.size());
+
+        uint32_t keyOffset = 0;
+        for (std::size_t i = 0; i < kCount; ++i) {
+            auto* e = new (fmt::entryAt(mBase, i, mCapacity)) fmt::Entry{};
+            for (uint32_t w = 0; w < mCapacity / 8; ++w) {
+                new (fmt::strWords(e) + w) std::atomic<uint64_t>(0);
+            }
+            const AbstractCV* val = mCfg.find(static_cast<TConfigEnum>(i));
+            if (val == nullptr) {
+                continue;
+            }
+            e->present = 1;
+            e->kind = static_cast<uint8_t>(val->kind());
+            e->updatable = val->updatable() ? 1 : 0;
+            e->keyOffset = keyOffset;
+            e->keyLength = static_cast<uint32_t>(val->key().size());
+            keyOffset += e->keyLength;
+        }
+        try {
+            publish();
+        } catch (...) {
+            ::munmap(mBase, mSize);
+            unlinkIfOurs();
+            throw;
+        }
+        hdr->ready.store(1, std::memory_order_release);
+    }
+
+    SharedConfigPublisher(const SharedConfigPublisher&) = delete;
+    SharedConfigPublisher& operator=(const SharedConfigPublisher&) = delete;
+
+    ~SharedConfigPublisher()
+    {
+        ::munmap(mBase, mSize);
+        unlinkIfOurs();
+    }
+
+    /// Set a config value and publish it
+    /// @return SetError::None if the value was applied.  SetError::OutOfRange
+    ///         if its string form would not fit in the segment.
+    SetError trySet(TConfigEnum parm, std::string_view newVal) {
+        return setMany({ { parm, std::string(newVal) } })[0];
+    }
+
+    /// Set several config values as one update and publish them together.
+    /// See ConfigTemplate::setMany().  Values whose string form is too long
+    /// for the segment fail with SetError::OutOfRange, the rest report
+    /// SetError::BatchRejected, and nothing is applied.
+    std::vector<SetError> setMany(const std::vector<std::pair<TConfigEnum, std::string>>& updates) {
+        std::lock_guard<std::mutex> lock(mMutex);
+        std::vector<SetError> results = mCfg.setMany(updates, [this](TConfigEnum parm, const PendingConfig<TConfigEnum>& next) {
+            CVStrBuf scratch;
+            return next.asStrView(parm, scratch).size() > mCapacity ? SetError::OutOfRange : SetError::None;
+        });
+        if (std::all_of(results.begin(), results.end(), [](SetError e) { return e == SetError::None; })) {
+            write([&] {
+                for (auto& u : updates) {
+                    store(enumIndex(u.first));
+                }
+            });
+        }
+        return results;
+    }
+
+    /// Write every value in the config to the segment as one update
+    /// Throws std::length_error if a string value doesn't fit.
+    void publish() {
+        std::lock_guard<std::mutex> lock(mMutex);
+        for (std::size_t i = 0; i < kCount; ++i) {
+            const AbstractCV* val = mCfg.find(static_cast<TConfigEnum>(i));
+            CVStrBuf scratch;
+            if (val != nullptr && val->asStrView(scratch).size() > mCapacity) {
+                throw std::length_error("Config value too long for shared config: " + std::string(val->key()));
+            }
+        }
+        write([&] {
+            for (std::size_t i = 0; i < kCount; ++i) {
+                store(i);
+            }
+        });
+    }
+
+    /// Return the shared memory object name
+    const std::string& name() const { return mName; }
+
+private:
+    static constexpr std::size_t kCount = ConfigEnumCount<TConfigEnum>::value;
+
+    cfg_shm_format::Header& header() const { return *static_cast<cfg_shm_format::Header*>(mBase); }
+
+    /// Run stores inside one odd/even sequence update
+    template <typename Fn>
+    void write(Fn&& stores) {
+        auto& seq = header().seq;
+        uint64_t s = seq.load(std::memory_order_relaxed);
+        seq.store(s + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        stores();
+        seq.store(s + 2, std::memory_order_release);
+    }
+
+    /// Copy one value from the config into its entry
+    void store(std::size_t idx) {
+        namespace fmt = cfg_shm_format;
+        const AbstractCV* val = mCfg.find(static_cast<TConfigEnum>(idx));
+        if (val == nullptr) {
+            return;
+        }
+        fmt::Entry* e = fmt::entryAt(mBase, idx, mCapacity);
+        bool hasInt = val->hasInt();
+        e->intVal.store(hasInt ? val->asInt() : 0, std::memory_order_relaxed);
+        e->flags.store((hasInt ? fmt::kHasInt : 0) | (val->asBool() ? fmt::kBool : 0), std::memory_order_relaxed);
+        CVStrBuf scratch;
+        std::string_view str = val->asStrView(scratch);
+        // setMany() and publish() reject values that don't fit, but one set
+        // on the config directly may not, so never write past the buffer
+        str = str.substr(0, mCapacity);
+        e->strLength.store(static_cast<uint32_t>(str.size()), std::memory_order_relaxed);
+        std::atomic<uint64_t>* words = fmt::strWords(e);
+        for (std::size_t off = 0; off < str.size(); off += 8) {
+            uint64_t w = 0;
+            std::memcpy(&w, str.data() + off, std::min<std::size_t>(8, str.size() - off));
+            words[off / 8].store(w, std::memory_order_relaxed);
+        }
+    }
+
+    /// Unlink mName, unless a newer publisher has replaced our segment
+    void unlinkIfOurs() {
+        int fd = ::shm_open(mName.c_str(), O_RDONLY | O_CLOEXEC, 0);
+        if (fd < 0) {
+            return;
+        }
+        struct stat st;
+        bool ours = ::fstat(fd, &st) == 0 && st.st_dev == mDev && st.st_ino == mIno;
+        ::close(fd);
+        if (ours) {
+            ::shm_unlink(mName.c_str());
+        }
+    }
+
+    std::string mName;
+    Config& mCfg;
+    uint32_t mCapacity;
+    std::size_t mSize = 0;
+    void* mBase = nullptr;
+    /// Identity of our segment, to tell it apart from a newer one under mName
+    dev_t mDev = 0;
+    ino_t mIno = 0;
+    std::mutex mMutex;
+};
+
+/**
+   Read-only view of a config published by SharedConfigPublisher.
+
+   Reads never lock or make system calls: they load the value's atomics
+   between two loads of the segment's sequence count and retry if a publish
+   overlapped them.  Keys and kinds come straight from the mapping.
+*/
+template <typename TConfigEnum>
+class SharedConfig
+{
+public:
+    /// Constructor for enums with a ConfigRegistry, which know their schema
+    /// at compile time.  See SharedConfig(const std::string&, uint64_t).
+    explicit SharedConfig(const std::string& name)
+        : SharedConfig(name, registrySchema<TConfigEnum>())
+    {
+    }
+
+    /// Constructor
+    /// Throws std::runtime_error if the segment is missing, not yet ready, or
+    /// was published for a config with a different schema.
+    /// @param[in] name Shared memory object name the publisher used
+    /// @param[in] schema Expected schema fingerprint, e.g. configSchema() of
+    ///            a config built by this process
+    SharedConfig(const std::string& name, uint64_t schema)
+    {
+        int fd = ::shm_open(name.c_str(), O_RDONLY | O_CLOEXEC, 0);
+        if (fd < 0) {
+            throw std::runtime_error("Cannot open shared config: " + name);
+        }
+        struct stat st;
+        if (::fstat(fd, &st) != 0 || st.st_size < static_cast<off_t>(sizeof(Header))) {
+            ::close(fd);
+            throw std::runtime_error("Shared config is not ready: " + name);
+        }
+        mSize = static_cast<std::size_t>(st.st_size);
+        void* base = ::mmap(nullptr, mSize, PROT_READ, MAP_SHARED, fd, 0);
+        ::close(fd);
+        if (base == MAP_FAILED) {
+            throw std::runtime_error("Cannot map shared config: " + name);
+        }
+        mBase = base;
+        try {
+            validate(name, schema);
+        } catch (...) {
+            ::munmap(mBase, mSize);
+            throw;
+        }
+        mCapacity = header().strCapacity;
+    }
+
+    SharedConfig(const SharedConfig&) = delete;
+    SharedConfig& operator=(const SharedConfig&) = delete;
+
+    ~SharedConfig() { ::munmap(mBase, mSize); }
+
+    /// Get a config value as a specific type
+    /// Throws std::out_of_range if the parm was not published, and
+    /// std::invalid_argument if an integer is asked of a value without one.
+    /// @tparam T The type to get the value as.
+    /// @param[in] parm Config parm to lookup
+    template <typename T>
+    T as_(TConfigEnum parm) const {
+        cfg_shm_format::Entry* e = entry(parm);
+        if constexpr (std::is_same<T, std::string>::value) {
+            std::string out;
+            read([&] {
+                uint32_t len = std::min(e->strLength.load(std::memory_order_relaxed), mCapacity);
+                out.resize(len);
+                const std::atomic<uint64_t>* words = cfg_shm_format::strWords(e);
+                for (uint32_t off = 0; off < len; off += 8) {
+                    uint64_t w = words[off / 8].load(std::memory_order_relaxed);
+                    std::memcpy(&out[off], &w, std::min<uint32_t>(8, len - off));
+                }
+            });
+            return out;
+        } else if constexpr (std::is_same<T, bool>::value) {
+            return (e->flags.load(std::memory_order_acquire) & cfg_shm_format::kBool) != 0;
+        } else {
+            uint32_t flags;
+            int64_t val;
+            read([&] {
+                flags = e->flags.load(std::memory_order_relaxed);
+                val = e->intVal.load(std::memory_order_relaxed);
+            });
+            if (!(flags & cfg_shm_format::kHasInt)) {
+                throw std::invalid_argument("Config value is not an integer: " + std::string(key(parm)));
+            }
+            return static_cast<T>(val);
+        }
+    }
+
+    /// Get a config value as a specific type without throwing for unknown parms.
+    /// @return false if the parm was not published
+    template <typename T>
+    bool tryAs_(TConfigEnum parm, T& returnVal) const {
+        if (!contains(parm)) {
+            return false;
+        }
+        returnVal = as_<T>(parm);
+        return true;
+    }
+
+    /// Return true if the parm was registered in the published config
+    bool contains(TConfigEnum parm) const noexcept {
+        return enumIndex(parm) < kCount && entryAt(enumIndex(parm))->present;
+    }
+
+    /// Return the string name of a config parm
+    std::string_view key(TConfigEnum parm) const {
+        cfg_shm_format::Entry* e = entry(parm);
+        return std::string_view(static_cast<const char*>(mBase) + header().keysOffset + e->keyOffset, e->keyLength);
+    }
+
+    /// Return the storage kind of a config parm
+    CVKind kind(TConfigEnum parm) const { return static_cast<CVKind>(entry(parm)->kind); }
+
+    /// Return the publish count.  It changes with every publish, so readers
+    /// can cache values and only reload them when it moves.  It is odd while
+    /// a publish is in progress.
+    uint64_t version() const { return header().seq.load(std::memory_order_acquire); }
+
+private:
+    using Header = cfg_shm_format::Header;
+
+    static constexpr std::size_t kCount = ConfigEnumCount<TConfigEnum>::value;
+
+    const Header& header() const { return *static_cast<const Header*>(mBase); }
+
+    cfg_shm_format::Entry* entryAt(std::size_t idx) const {
+        return cfg_shm_format::entryAt(mBase, idx, header().strCapacity);
+    }
+
+    cfg_shm_format::Entry* entry(TConfigEnum parm) const {
+        if (!contains(parm)) {
+            throw std::out_of_range("Unknown config parm: " + std::to_string(enumIndex(parm)));
+        }
+        return entryAt(enumIndex(parm));
+    }
+
+    /// Run loads until they complete without overlapping a publish
+    template <typename Fn>
+    void read(Fn&& loads) const {
+        const auto& seq = header().seq;
+        while (true) {
+            uint64_t s = seq.load(std::memory_order_acquire);
+            if (s & 1) {
+                continue;
+            }
+            loads();
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (seq.load(std::memory_order_relaxed) == s) {
+                return;
+            }
+        }
+    }
+
+    /// Check the header and that every key lies inside the segment
+    void validate(const std::string& name, uint64_t schema) const {
+        const Header& hdr = header();
+        if (hdr.ready.load(std::memory_order_acquire) != 1) {
+            throw std::runtime_error("Shared config is not ready: " + name);
+        }
+        if (std::memcmp(hdr.magic, cfg_shm_format::kMagic, sizeof(hdr.magic)) != 0
+            || hdr.version != cfg_shm_format::kVersion) {
+            throw std::runtime_error("Not a supported shared config: " + name);
+        }
+        if (hdr.count != kCount || hdr.schema != schema || hdr.size != mSize || hdr.strCapacity % 8 != 0
+            || hdr.keysOffset != sizeof(Header) + kCount * cfg_shm_format::entryStride(hdr.strCapacity)
+            || hdr.keysOffset > mSize) {
+            throw std::runtime_error("Shared config does not match this config: " + name);
+        }
+        uint64_t keysSize = mSize - hdr.keysOffset;
+        for (std::size_t i = 0; i < kCount; ++i) {
+            const cfg_shm_format::Entry* e = entryAt(i);
+            if (e->present && uint64_t(e->keyOffset) + e->keyLength > keysSize) {
+                throw std::runtime_error("Shared config is corrupt: " + name);
+            }
+        }
+    }
+
+    void* mBase = nullptr;
+    std::size_t mSize = 0;
+    uint32_t mCapacity = 0;
+};
@@ -0,0 +1,185 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+#include "cfg_template.hpp"
+
+/**
+   Config that is updated by publishing whole immutable versions.
+
+   Every version is a complete ConfigTemplate.  A writer builds the next
+   version off to the side and publishes it with a single pointer swap, so a
+   multi-parameter update becomes visible to readers all at once.  Readers take
+   a Snapshot handle, which pins the version that was current at that moment.
+   Taking and releasing a handle is wait-free; it never blocks on writers or
+   on other readers.
+
+   Old versions are reclaimed with epoch-based reclamation.  Each reader
+   handle occupies a slot stamped with the global epoch at the time it was
+   taken.  A retired version is freed once no occupied slot carries an epoch
+   from before it was retired.
+*/
+template <typename TConfigEnum>
+class SnapshotConfig
+{
+public:
+    using Config = ConfigTemplate<TConfigEnum>;
+
+    /// Maximum number of snapshot handles that can be held at the same time
+    static constexpr std::size_t kMaxReaders = 256;
+
+    /**
+       Handle to a pinned config version.
+
+       The version stays valid for as long as the handle is alive.  Handles
+       are meant to be short lived, e.g. one per request or per batch.
+    */
+    class Snapshot
+    {
+        friend class SnapshotConfig;
+
+        std::atomic<uint64_t>* mSlot;
+        const Config* mCfg;
+
+        Snapshot(std::atomic<uint64_t>* slot, const Config* cfg)
+            : mSlot(slot), mCfg(cfg)
+        {
+        }
+
+    public:
+        Snapshot(Snapshot&& other) noexcept
+            : mSlot(other.mSlot), mCfg(other.mCfg)
+        {
+            other.mSlot = nullptr;
+            other.mCfg = nullptr;
+        }
+
+        Snapshot(const Snapshot&) = delete;
+        Snapshot& operator=(const Snapshot&) = delete;
+        Snapshot& operator=(Snapshot&&) = delete;
+
+        ~Snapshot()
+        {
+            if (mSlot != nullptr) {
+                mSlot->store(0, std::memory_order_release);
+            }
+        }
+
+        const Config& operator*() const { return *mCfg; }
+        const Config* operator->() const { return mCfg; }
+    };
+
+    /// Constructor
+    /// @param[in] overrides List of key/value pairs for the initial version.
+    SnapshotConfig(std::map<std::string, std::string> overrides)
+        : mOverrides(std::move(overrides))
+        , mCurrent(new Config(mOverrides))
+    {
+    }
+
+    SnapshotConfig(const SnapshotConfig&) = delete;
+    SnapshotConfig& operator=(const SnapshotConfig&) = delete;
+
+    /// Destructor.  No Snapshot handles may outlive the SnapshotConfig.
+    ~SnapshotConfig()
+    {
+        delete mCurrent.load();
+        for (auto& r : mRetired) {
+            delete r.first;
+        }
+    }
+
+    /// Take a handle to the current version
+    /// Throws std::runtime_error if kMaxReaders handles are already held.
+    Snapshot acquire() const
+    {
+        thread_local std::size_t hint = 0;
+        uint64_t epoch = mEpoch.load();
+        for (std::size_t i = 0; i < kMaxReaders; ++i) {
+            std::size_t idx = (hint + i) % kMaxReaders;
+            auto& slot = mSlots[idx].epoch;
+            uint64_t idle = 0;
+            if (slot.load(std::memory_order_relaxed) == 0 && slot.compare_exchange_strong(idle, epoch)) {
+                hint = idx;
+                return Snapshot(&slot, mCurrent.load());
+            }
+        }
+        throw std::runtime_error("Too many concurrent config snapshots");
+    }
+
+    /// Publish a new version with a set of parms changed together
+    ///
+    /// Throws if any parm is unknown or read-only, in which case nothing is
+    /// published.
+    /// @param[in] updates Pairs of config parm and its new value
+    void publish(const std::vector<std::pair<TConfigEnum, std::string>>& updates)
+    {
+        std::lock_guard<std::mutex> lock(mWriterMutex);
+        const Config* cur = mCurrent.load();
+        std::map<std::string, std::string> next = mOverrides;
+        for (auto& u : updates) {
+            const AbstractCV* val = cur->find(u.first);
+            if (val == nullptr) {
+                throw std::out_of_range("Unknown config parm: " + std::to_string(enumIndex(u.first)));
+            }
+            if (!val->updatable()) {
+                throw std::runtime_error("Read-only config value.  Set is not supported: " + std::string(val->key()));
+            }
+            next[std::string(val->key())] = u.second;
+        }
+
+        std::unique_ptr<const Config> nextCfg(new Config(next));
+        mOverrides = std::move(next);
+        const Config* old = mCurrent.exchange(nextCfg.release());
+        mRetired.emplace_back(old, mEpoch.fetch_add(1));
+        reclaim();
+    }
+
+private:
+    /// Reader slot, padded so readers on different cores don't share a line
+    struct alignas(kCacheLineSize) ReaderSlot {
+        /// Epoch the reader entered at, or 0 if the slot is free
+        std::atomic<uint64_t> epoch{0};
+    };
+
+    /// Free every retired version that no reader can still be using
+    void reclaim()
+    {
+        uint64_t minActive = UINT64_MAX;
+        for (auto& s : mSlots) {
+            uint64_t e = s.epoch.load();
+            if (e != 0 && e < minActive) {
+                minActive = e;
+            }
+        }
+        auto it = mRetired.begin();
+        while (it != mRetired.end()) {
+            if (it->second < minActive) {
+                delete it->first;
+                it = mRetired.erase(it);
+            } else {
+                ++it;
+            }
+        }
+    }
+
+    /// Overrides the current version was built from
+    std::map<std::string, std::string> mOverrides;
+    /// Current version
+    std::atomic<const Config*> mCurrent;
+    /// Global epoch.  Bumped each time a version is retired.
+    mutable std::atomic<uint64_t> mEpoch{1};
+    /// Slots for the readers holding a Snapshot
+    mutable std::array<ReaderSlot, kMaxReaders> mSlots;
+    /// Retired versions and the epoch they were retired in
+    std::vector<std::pair<const Config*, uint64_t>> mRetired;
+    /// Serializes writers
+    std::mutex mWriterMutex;
+};
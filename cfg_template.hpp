@@ -1,20 +1,353 @@
+#pragma once
+
+/// Build with -DCFG_TEMPLATE_STATS=1 to compile in access instrumentation (see
+/// ConfigTemplate::enableStats()).  Without it the hooks compile to nothing.
+#ifndef CFG_TEMPLATE_STATS
+#define CFG_TEMPLATE_STATS 0
+#endif
+
 #include <map>
 #include <memory>
+#include <memory_resource>
+#include <mutex>
+#include <new>
 #include <algorithm>
+#include <array>
+#include <cassert>
+#include <charconv>
+#include <atomic>
+#include <bitset>
+#include <chrono>
+#include <cstddef>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <initializer_list>
+#include <iterator>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
 
 
+/// Helper to compare two strings ignoring ASCII case
+inline bool strIEquals(std::string_view a, std::string_view b)
+{
+    return a.size() == b.size()
+        && std::equal(a.begin(), a.end(), b.begin(), [](char x, char y) {
+               return ::toupper(static_cast<unsigned char>(x)) == ::toupper(static_cast<unsigned char>(y));
+           });
+}
+
 /// Helper to convert a string value to a bool
-bool strToBool(const std::string in)
+inline bool strToBool(std::string_view in)
 {
-    std::string upStr = in;
-    std::transform(upStr.begin(), upStr.end(), upStr.begin(), ::toupper);
-    if (upStr == "0" || upStr == "FALSE" || upStr == "OFF") {
+    if (in == "0" || strIEquals(in, "FALSE") || strIEquals(in, "OFF")) {
         return false;
     } else {
         return true;
     }
 }
 
+/// Strictly parse a bool: 1/0, true/false, on/off in any case
+/// @return false if the text is none of those
+inline bool parseBool(std::string_view in, bool& out)
+{
+    if (in == "1" || strIEquals(in, "TRUE") || strIEquals(in, "ON")) {
+        out = true;
+    } else if (in == "0" || strIEquals(in, "FALSE") || strIEquals(in, "OFF")) {
+        out = false;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+/// Outcome of parsing a config value
+enum class ParseError : uint8_t {
+    None,
+    /// Nothing to parse
+    Empty,
+    /// Not a number
+    Invalid,
+    /// The number does not fit the target type
+    OutOfRange,
+    /// The number has a unit suffix that isn't recognized
+    BadSuffix,
+};
+
+/// What an integer config value measures, which picks the unit suffixes
+/// it accepts
+enum class IntUnit : uint8_t {
+    /// A plain number, with no suffix
+    None,
+    /// Bytes, with suffixes in powers of 1024
+    Size,
+    /// Milliseconds, the unit used by time parms such as ZK_TIMEOUT
+    Duration,
+};
+
+/// Unit suffixes accepted after an integer config value of their IntUnit.
+/// Matched case-insensitively.
+struct IntSuffix {
+    std::string_view name;
+    int64_t multiplier;
+    IntUnit unit;
+};
+
+constexpr IntSuffix kIntSuffixes[] = {
+    { "B", 1, IntUnit::Size },
+    { "K", int64_t(1) << 10, IntUnit::Size },
+    { "KB", int64_t(1) << 10, IntUnit::Size },
+    { "M", int64_t(1) << 20, IntUnit::Size },
+    { "MB", int64_t(1) << 20, IntUnit::Size },
+    { "G", int64_t(1) << 30, IntUnit::Size },
+    { "GB", int64_t(1) << 30, IntUnit::Size },
+    { "T", int64_t(1) << 40, IntUnit::Size },
+    { "TB", int64_t(1) << 40, IntUnit::Size },
+    { "ms", 1, IntUnit::Duration },
+    { "s", 1000, IntUnit::Duration },
+    { "min", 60 * 1000, IntUnit::Duration },
+    { "h", 60 * 60 * 1000, IntUnit::Duration },
+    { "d", 24 * 60 * 60 * 1000, IntUnit::Duration },
+};
+
+/// Return true if an integer value is representable in IntType
+template <typename IntType, typename ValType>
+constexpr bool intFits(ValType v) noexcept
+{
+    static_assert(std::is_integral<IntType>::value && std::is_integral<ValType>::value, "Integer type expected");
+    if constexpr (std::is_signed<ValType>::value == std::is_signed<IntType>::value) {
+        return v >= std::numeric_limits<IntType>::min() && v <= std::numeric_limits<IntType>::max();
+    } else if constexpr (std::is_signed<ValType>::value) {
+        return v >= 0 && static_cast<std::make_unsigned_t<ValType>>(v) <= std::numeric_limits<IntType>::max();
+    } else {
+        return v <= static_cast<std::make_unsigned_t<IntType>>(std::numeric_limits<IntType>::max());
+    }
+}
+
+/// Parse an integer config value without throwing or allocating.
+///
+/// Accepts an optional sign, decimal digits and an optional unit suffix from
+/// kIntSuffixes, e.g. "4GB" for a size or "10s" for a duration.  The result
+/// is range checked against IntType.  Parsing does not depend on the locale.
+/// @param[in] in Text to parse
+/// @param[out] out Parsed value.  Only written on success.
+/// @param[in] unit What the value measures.  Suffixes of other units fail
+///            with ParseError::BadSuffix.
+template <typename IntType>
+ParseError parseInt(std::string_view in, IntType& out, IntUnit unit = IntUnit::None) noexcept
+{
+    static_assert(std::is_integral<IntType>::value, "Integer type expected");
+    if (in.empty()) {
+        return ParseError::Empty;
+    }
+    const char* first = in.data();
+    const char* last = in.data() + in.size();
+    if (*first == '+') {
+        ++first;
+    }
+    int64_t val = 0;
+    auto res = std::from_chars(first, last, val);
+    if (res.ec == std::errc::result_out_of_range) {
+        return ParseError::OutOfRange;
+    } else if (res.ec != std::errc() || (first != in.data() && *first == '-')) {
+        return ParseError::Invalid;
+    }
+
+    std::string_view suffix(res.ptr, last - res.ptr);
+    if (!suffix.empty()) {
+        const IntSuffix* match = nullptr;
+        for (const auto& s : kIntSuffixes) {
+            if (s.unit == unit && strIEquals(suffix, s.name)) {
+                match = &s;
+                break;
+            }
+        }
+        if (match == nullptr) {
+            return ParseError::BadSuffix;
+        }
+        if (val > INT64_MAX / match->multiplier || val < INT64_MIN / match->multiplier) {
+            return ParseError::OutOfRange;
+        }
+        val *= match->multiplier;
+    }
+
+    using Limits = std::numeric_limits<IntType>;
+    if (Limits::is_signed ? (val < int64_t(Limits::min()) || val > int64_t(Limits::max()))
+                          : (val < 0 || uint64_t(val) > uint64_t(Limits::max()))) {
+        return ParseError::OutOfRange;
+    }
+    out = static_cast<IntType>(val);
+    return ParseError::None;
+}
+
+/// Helper to convert a string value to an integer type
+/// Throws std::invalid_argument or std::out_of_range if it doesn't parse.
+template <typename IntType>
+IntType strToInt(std::string_view in, IntUnit unit = IntUnit::None)
+{
+    IntType out{};
+    ParseError err = parseInt(in, out, unit);
+    if (err == ParseError::OutOfRange) {
+        throw std::out_of_range("Config value out of range: " + std::string(in));
+    } else if (err != ParseError::None) {
+        throw std::invalid_argument("Invalid integer config value: " + std::string(in));
+    }
+    return out;
+}
+
+/// Cache line size assumed for padding hot values
+constexpr std::size_t kCacheLineSize = 64;
+
+/// Scratch space large enough to render any 64-bit integer as a string.
+/// Used by AbstractCV::asStrView() for values that cannot cache their string.
+using CVStrBuf = std::array<char, 24>;
+
+/// How a config value holds on to its key and help text
+enum class CVText : uint8_t {
+    /// Copy the text into the config value's memory resource
+    Copy,
+    /// The text has static storage duration (e.g. a ConfigRegistry), so only
+    /// views of it are kept
+    Static,
+};
+
+/// Storage kind of a config value
+enum class CVKind : uint8_t {
+    Int8,
+    Int16,
+    Int32,
+    Int64,
+    Bool,
+    Str,
+    /// One of a fixed set of names, mapped to a C++ enum (see EnumReadOnlyCV)
+    Enum,
+};
+
+/// Map an integer storage type to its CVKind
+template <typename IntType>
+constexpr CVKind cvKindOf()
+{
+    static_assert(std::is_integral<IntType>::value, "Integer type expected");
+    switch (sizeof(IntType)) {
+    case 1: return CVKind::Int8;
+    case 2: return CVKind::Int16;
+    case 4: return CVKind::Int32;
+    default: return CVKind::Int64;
+    }
+}
+
+/// Outcome of setting a config value
+enum class SetError : uint8_t {
+    None,
+    /// The parm or key is not registered in the config
+    UnknownParm,
+    /// The config value cannot be changed after construction
+    ReadOnly,
+    /// The new value could not be parsed for the config value's type
+    InvalidValue,
+    /// The new value does not fit the config value's type or its checks
+    OutOfRange,
+    /// The update would break a constraint between parms (see ConfigConstraints)
+    Constraint,
+    /// The update was valid, but not applied because another update in the
+    /// same batch failed
+    BatchRejected,
+};
+
+/// Return a short description of a SetError
+inline const char* setErrorStr(SetError err)
+{
+    switch (err) {
+    case SetError::None: return "ok";
+    case SetError::UnknownParm: return "unknown config parm";
+    case SetError::ReadOnly: return "read-only config value";
+    case SetError::InvalidValue: return "invalid config value";
+    case SetError::OutOfRange: return "config value out of range";
+    case SetError::Constraint: return "violates a config constraint";
+    case SetError::BatchRejected: return "not applied: another update in the batch failed";
+    }
+    return "unknown error";
+}
+
+/// New value parsed by AbstractCV::prepare(), ready to be committed
+struct PreparedValue {
+    int64_t i = 0;
+    bool b = false;
+    /// View of the text the value was parsed from
+    std::string_view s;
+    /// Storage built by prepare() for values that commit by swapping a pointer
+    std::shared_ptr<void> owned;
+};
+
+/**
+   Checks on the value of an integer parm.
+
+   A check is a type with a static constexpr check(int64_t) and is composed
+   with others at compile time, e.g. intCheck<AtLeast<0>, MultipleOf<4096>>().
+   The result is one plain function that the config value calls when it is
+   constructed and on each set, never on reads.  Values declared without
+   checks hold a null pointer.
+*/
+using IntCheck = bool (*)(int64_t);
+
+/// Value must be at least Min
+template <int64_t Min>
+struct AtLeast {
+    static constexpr bool check(int64_t v) { return v >= Min; }
+};
+
+/// Value must be at most Max
+template <int64_t Max>
+struct AtMost {
+    static constexpr bool check(int64_t v) { return v <= Max; }
+};
+
+/// Value must be a multiple of Step
+template <int64_t Step>
+struct MultipleOf {
+    static_assert(Step > 0, "Step must be positive");
+    static constexpr bool check(int64_t v) { return v % Step == 0; }
+};
+
+/// Value must pass every one of Checks
+template <typename... Checks>
+struct AllOf {
+    static constexpr bool check([[maybe_unused]] int64_t v) { return (Checks::check(v) && ...); }
+};
+
+/// Value must be in [Min, Max]
+template <int64_t Min, int64_t Max>
+struct InRange : AllOf<AtLeast<Min>, AtMost<Max>> {
+    static_assert(Min <= Max, "Empty range");
+};
+
+/// Fold checks into the function an integer config value calls
+/// @return nullptr if there are no checks
+template <typename... Checks>
+constexpr IntCheck intCheck()
+{
+    if constexpr (sizeof...(Checks) == 0) {
+        return nullptr;
+    } else {
+        return &AllOf<Checks...>::check;
+    }
+}
+
+/// Throw std::out_of_range if an integer value fails its checks
+inline void checkIntValue(IntCheck check, std::string_view key, int64_t v)
+{
+    if (check != nullptr && !check(v)) {
+        throw std::out_of_range("Config value out of range for " + std::string(key) + ": " + std::to_string(v));
+    }
+}
+
 /**
    Abstract config value.
 
@@ -22,40 +355,122 @@ bool strToBool(const std::string in)
    Specific subclass will add a specific type and implement the APIs.
 */
 class AbstractCV {
+    /// Key and help text stored back to back in one allocation
+    std::pmr::string mStorage;
     /// String representation of the config value.  Used for debug purposes
-    std::string mKey;
+    std::string_view mKey;
     /// Help text to describe the type of values can be set for the config
     /// value and how the config value is used.
-    std::string mHelp;
+    std::string_view mHelp;
 
 public:
     /// Constructor
     /// @param[in] key String name of the config value
     /// @param[in] help Help text to describe the config value
-    AbstractCV(const std::string& key, const std::string& help)
-        : mKey(key), mHelp(help)
+    /// @param[in] resource Memory resource the key and help text are copied into
+    /// @param[in] text Whether the key and help text need to be copied
+    AbstractCV(std::string_view key, std::string_view help,
+               std::pmr::memory_resource* resource = std::pmr::get_default_resource(),
+               CVText text = CVText::Copy)
+        : mStorage(resource), mKey(key), mHelp(help)
     {
+        if (text == CVText::Copy) {
+            mStorage.reserve(key.size() + help.size());
+            mStorage.append(key).append(help);
+            mKey = std::string_view(mStorage.data(), key.size());
+            mHelp = std::string_view(mStorage.data() + key.size(), help.size());
+        }
     }
 
+    virtual ~AbstractCV() = default;
+
+    AbstractCV(const AbstractCV&) = delete;
+    AbstractCV& operator=(const AbstractCV&) = delete;
+
     /// Return the help text
-    virtual const std::string& help() const { return mHelp; }
+    virtual std::string_view help() const { return mHelp; }
 
     /// Return the string name of the config parm
-    virtual const std::string& key() const { return mKey; }
+    virtual std::string_view key() const { return mKey; }
 
     /// Return the value as a string
     virtual std::string asStr() const = 0;
 
+    /// Return the value as a string without allocating.
+    ///
+    /// Read-only values return a view of a string rendered at construction.
+    /// Updatable values render the current value into scratch, so the view is
+    /// only valid as long as scratch is.
+    /// @param[in] scratch Buffer the value may be rendered into
+    virtual std::string_view asStrView(CVStrBuf& scratch) const = 0;
+
     /// Return the value as 64-bit int
     virtual int64_t asInt() const = 0;
 
     /// Return the value as a bool
     virtual bool asBool() const = 0;
 
+    /// Return the storage kind of the value
+    virtual CVKind kind() const = 0;
+
+    /// Return true if asInt() can be called without throwing
+    virtual bool hasInt() const { return true; }
+
+    /// Return true if the value can be changed after construction
+    virtual bool updatable() const { return false; }
+
+    /// Identify the C++ enum an enumerated value holds
+    /// @return &cvEnumTag<EnumType> for an EnumReadOnlyCV<EnumType>, else nullptr
+    virtual const void* enumTag() const { return nullptr; }
+
+    /// Make a config value of the same type, key and help text with a new value.
+    ///
+    /// The new value keeps views of this value's key and help text, so this
+    /// value must outlive it.
+    /// @param[in] v New value, parsed the same way as an override
+    /// @param[in] resource Memory resource to allocate the new value from
+    virtual std::shared_ptr<AbstractCV> rebind(std::string_view v, std::pmr::memory_resource* resource) const = 0;
+
+    /// Move the value into a cache line owned by the config.
+    /// Only done at construction time, before the value is shared.
+    /// @param[in] line Cache line aligned storage of kCacheLineSize bytes
+    /// @return false if this value has nothing to move
+    virtual bool moveHotValue([[maybe_unused]] void* line) { return false; }
+
+    /// Parse and validate a new value without applying it.
+    /// Default is to reject the value as read-only.  Updatable subclasses
+    /// override this and commit().
+    /// @param[in] v New value
+    /// @param[out] out Parsed form of the value, to pass to commit()
+    /// @return SetError::None if the value can be committed
+    virtual SetError prepare([[maybe_unused]] std::string_view v, [[maybe_unused]] PreparedValue& out) const {
+        return SetError::ReadOnly;
+    }
+
+    /// Apply a value that prepare() accepted
+    virtual void commit([[maybe_unused]] const PreparedValue& v) {}
+
     /// Set a new config value.  
     /// Default value is to prevent the set.  This can be overridden in a subclass.
     virtual void set(const std::string& v) { 
-        throw std::runtime_error("Read-only config value.  Set is not supported: " + key());
+        PreparedValue pv;
+        SetError err = prepare(v, pv);
+        if (err != SetError::None) {
+            throwSetError(err, v);
+        }
+        commit(pv);
+    }
+
+    /// Throw the exception set() uses for an error returned by prepare()
+    /// @param[in] err Error other than SetError::None
+    /// @param[in] v Value that was rejected
+    [[noreturn]] void throwSetError(SetError err, std::string_view v) const {
+        if (err == SetError::ReadOnly) {
+            throw std::runtime_error("Read-only config value.  Set is not supported: " + std::string(key()));
+        } else if (err == SetError::OutOfRange) {
+            throw std::out_of_range("Config value out of range for " + std::string(key()) + ": " + std::string(v));
+        }
+        throw std::invalid_argument("Invalid config value for " + std::string(key()) + ": " + std::string(v));
     }
 };
 
@@ -65,18 +480,43 @@ public:
    set() will throw if called.
 */
 template <typename IntType>
-class IntReadOnlyCV : public AbstractCV {
+class IntReadOnlyCV final : public AbstractCV {
     IntType mVal;
+    /// String rendering of mVal, cached so string reads don't allocate
+    std::pmr::string mStr;
+    /// Checks on the value, kept for rebind()
+    IntCheck mCheck;
+    /// Unit suffixes overrides may use, kept for rebind()
+    IntUnit mUnit;
 
 public:
-    IntReadOnlyCV(IntType defVal, const std::string& key, const std::string& help) 
-        : AbstractCV(key, help), mVal(defVal)
+    using value_type = IntType;
+
+    /// Throws std::out_of_range if the value fails check.
+    IntReadOnlyCV(IntType defVal, std::string_view key, std::string_view help,
+                  std::pmr::memory_resource* resource = std::pmr::get_default_resource(),
+                  CVText text = CVText::Copy, IntCheck check = nullptr, IntUnit unit = IntUnit::None)
+        : AbstractCV(key, help, resource, text), mVal(defVal), mStr(resource), mCheck(check), mUnit(unit)
     {
+        checkIntValue(mCheck, this->key(), mVal);
+        CVStrBuf buf;
+        auto res = std::to_chars(buf.data(), buf.data() + buf.size(), mVal);
+        mStr.assign(buf.data(), res.ptr);
     }
 
-    virtual std::string asStr() const override { return std::to_string(mVal); }
+    /// Return the value in its storage type.  Non-virtual for typed access.
+    IntType value() const { return mVal; }
+
+    virtual CVKind kind() const override { return cvKindOf<IntType>(); }
+    virtual std::string asStr() const override { return std::string(mStr); }
+    virtual std::string_view asStrView(CVStrBuf&) const override { return mStr; }
     virtual int64_t asInt() const override { return mVal; }
     virtual bool asBool() const override { return (mVal) ? true : false; }
+    virtual std::shared_ptr<AbstractCV> rebind(std::string_view v, std::pmr::memory_resource* resource) const override {
+        std::pmr::polymorphic_allocator<IntReadOnlyCV> alloc(resource);
+        return std::allocate_shared<IntReadOnlyCV>(alloc, strToInt<IntType>(v, mUnit), key(), help(), resource,
+                                                   CVText::Static, mCheck, mUnit);
+    }
 };
 
 /**
@@ -85,20 +525,68 @@ public:
    The integer type is wrapped in an atomic to allow for concurrent updates.
 */
 template <typename IntType>
-class IntUpdatableCV : public AbstractCV {
-    std::atomic<IntType> mVal;
+class IntUpdatableCV final : public AbstractCV {
+    static_assert(sizeof(std::atomic<IntType>) <= kCacheLineSize, "Value must fit in a cache line");
+
+    /// Inline storage for the value, used until moveHotValue() is called
+    std::atomic<IntType> mLocal;
+    /// Where the value lives.  Either mLocal or a line in a HotValueBlock.
+    std::atomic<IntType>* mVal;
+    /// Checks each new value must pass
+    IntCheck mCheck;
+    /// Unit suffixes new values may use
+    IntUnit mUnit;
 
 public:
-    IntUpdatableCV(IntType defVal, const std::string& key, const std::string& help) 
-        : AbstractCV(key, help), mVal(defVal)
+    using value_type = IntType;
+
+    /// Throws std::out_of_range if the initial value fails check.
+    IntUpdatableCV(IntType defVal, std::string_view key, std::string_view help,
+                   std::pmr::memory_resource* resource = std::pmr::get_default_resource(),
+                   CVText text = CVText::Copy, IntCheck check = nullptr, IntUnit unit = IntUnit::None)
+        : AbstractCV(key, help, resource, text), mLocal(defVal), mVal(&mLocal), mCheck(check), mUnit(unit)
     {
+        checkIntValue(mCheck, this->key(), defVal);
     }
 
-    virtual std::string asStr() const override { return std::to_string(mVal.load()); }
-    virtual int64_t asInt() const override { return mVal.load(); }
-    virtual bool asBool() const override { return (mVal.load()) ? true : false; }
-    virtual void set(const std::string& v) override {
-        mVal = std::stoi(v);
+    /// Return the value in its storage type.  Non-virtual for typed access.
+    IntType value() const { return mVal->load(); }
+
+    virtual bool updatable() const override { return true; }
+    virtual CVKind kind() const override { return cvKindOf<IntType>(); }
+    virtual std::string asStr() const override { return std::to_string(mVal->load()); }
+    virtual std::string_view asStrView(CVStrBuf& scratch) const override {
+        auto res = std::to_chars(scratch.data(), scratch.data() + scratch.size(), mVal->load());
+        return std::string_view(scratch.data(), res.ptr - scratch.data());
+    }
+    virtual int64_t asInt() const override { return mVal->load(); }
+    virtual bool asBool() const override { return (mVal->load()) ? true : false; }
+    virtual SetError prepare(std::string_view v, PreparedValue& out) const override {
+        IntType parsed;
+        switch (parseInt(v, parsed, mUnit)) {
+        case ParseError::None:
+            if (mCheck != nullptr && !mCheck(parsed)) {
+                return SetError::OutOfRange;
+            }
+            out.i = parsed;
+            return SetError::None;
+        case ParseError::OutOfRange:
+            return SetError::OutOfRange;
+        default:
+            return SetError::InvalidValue;
+        }
+    }
+    virtual void commit(const PreparedValue& v) override {
+        *mVal = static_cast<IntType>(v.i);
+    }
+    virtual bool moveHotValue(void* line) override {
+        mVal = new (line) std::atomic<IntType>(mLocal.load());
+        return true;
+    }
+    virtual std::shared_ptr<AbstractCV> rebind(std::string_view v, std::pmr::memory_resource* resource) const override {
+        std::pmr::polymorphic_allocator<IntUpdatableCV> alloc(resource);
+        return std::allocate_shared<IntUpdatableCV>(alloc, strToInt<IntType>(v, mUnit), key(), help(), resource,
+                                                    CVText::Static, mCheck, mUnit);
     }
 };
 
@@ -107,18 +595,31 @@ public:
 
    Set throws an exception if called.
 */
-class BoolReadOnlyCV : public AbstractCV {
+class BoolReadOnlyCV final : public AbstractCV {
     bool mVal;
 
 public:
-    BoolReadOnlyCV(bool defVal, const std::string& key, const std::string& help) 
-        : AbstractCV(key, help), mVal(defVal)
+    using value_type = bool;
+
+    BoolReadOnlyCV(bool defVal, std::string_view key, std::string_view help,
+                   std::pmr::memory_resource* resource = std::pmr::get_default_resource(),
+                   CVText text = CVText::Copy)
+        : AbstractCV(key, help, resource, text), mVal(defVal)
     {
     }
 
+    /// Return the value in its storage type.  Non-virtual for typed access.
+    bool value() const { return mVal; }
+
+    virtual CVKind kind() const override { return CVKind::Bool; }
     virtual std::string asStr() const override { return mVal ? "true" : "false"; }
+    virtual std::string_view asStrView(CVStrBuf&) const override { return mVal ? "true" : "false"; }
     virtual int64_t asInt() const override { return mVal; }
     virtual bool asBool() const override { return mVal; }
+    virtual std::shared_ptr<AbstractCV> rebind(std::string_view v, std::pmr::memory_resource* resource) const override {
+        std::pmr::polymorphic_allocator<BoolReadOnlyCV> alloc(resource);
+        return std::allocate_shared<BoolReadOnlyCV>(alloc, strToBool(v), key(), help(), resource, CVText::Static);
+    }
 };
 
 /**
@@ -126,173 +627,2605 @@ public:
 
    Set throws an exception if called.
 */
-class StrReadOnlyCV : public AbstractCV {
-    std::string mVal;
+class StrReadOnlyCV final : public AbstractCV {
+    std::pmr::string mVal;
+    /// Integer view of mVal, parsed once at construction
+    int64_t mInt = 0;
+    /// True if all of mVal parsed as an integer
+    bool mIsInt = false;
+    /// Bool view of mVal, parsed once at construction
+    bool mBool;
 
 public:
-    StrReadOnlyCV(const std::string& defVal, const std::string& key, const std::string& help) 
-        : AbstractCV(key, help), mVal(defVal)
+    using value_type = std::string_view;
+
+    StrReadOnlyCV(std::string_view defVal, std::string_view key, std::string_view help,
+                  std::pmr::memory_resource* resource = std::pmr::get_default_resource(),
+                  CVText text = CVText::Copy)
+        : AbstractCV(key, help, resource, text), mVal(defVal, resource), mBool(strToBool(defVal))
     {
+        const char* end = mVal.data() + mVal.size();
+        auto res = std::from_chars(mVal.data(), end, mInt);
+        mIsInt = !mVal.empty() && res.ec == std::errc() && res.ptr == end;
     }
 
-    virtual std::string asStr() const override { return mVal; }
-    virtual int64_t asInt() const override { return std::stoi(mVal); }
-    virtual bool asBool() const override { return strToBool(mVal); }
+    /// Return the value in its storage type.  Non-virtual for typed access.
+    std::string_view value() const { return mVal; }
+
+    /// Return true if the string holds an integer, so asInt() will not throw
+    bool isInt() const { return mIsInt; }
+
+    virtual bool hasInt() const override { return mIsInt; }
+    virtual CVKind kind() const override { return CVKind::Str; }
+    virtual std::string asStr() const override { return std::string(mVal); }
+    virtual std::string_view asStrView(CVStrBuf&) const override { return mVal; }
+    virtual int64_t asInt() const override {
+        if (!mIsInt) {
+            throw std::invalid_argument("Config value is not an integer: " + std::string(key()));
+        }
+        return mInt;
+    }
+    virtual bool asBool() const override { return mBool; }
+    virtual std::shared_ptr<AbstractCV> rebind(std::string_view v, std::pmr::memory_resource* resource) const override {
+        std::pmr::polymorphic_allocator<StrReadOnlyCV> alloc(resource);
+        return std::allocate_shared<StrReadOnlyCV>(alloc, v, key(), help(), resource, CVText::Static);
+    }
 };
 
 /**
-   Factory class that generates config values
+   Updatable boolean config value
 
-   Handles picking of the initial value by using the hard-coded default and the
-   value defined in a map.
+   Set accepts 1/0, true/false and on/off, in any case.
 */
-class CVFactory
-{
-    /// Key/value pairs of override values.  The key names are the config value
-    /// parameter names.  If a value is missing from this map, then we will
-    /// just use the hard coded default value.
-    const std::map<std::string, std::string>& mOverrides;
+class BoolUpdatableCV final : public AbstractCV {
+    /// Inline storage for the value, used until moveHotValue() is called
+    std::atomic<bool> mLocal;
+    /// Where the value lives.  Either mLocal or a line in a HotValueBlock.
+    std::atomic<bool>* mVal;
 
 public:
-    /// Constructor
-    /// @param[in] override Pairs of key/value that override specific config values.
-    CVFactory(const std::map<std::string, std::string>& overrides)
-        : mOverrides(overrides)
-    {
-    }
+    using value_type = bool;
 
-    /// Make a read-only config value internally stored as an integer
-    template <typename IntType>
-    std::shared_ptr<AbstractCV>
-    Make_IntReadOnlyCV(const std::string& key, IntType defVal, const std::string& help)
+    BoolUpdatableCV(bool defVal, std::string_view key, std::string_view help,
+                    std::pmr::memory_resource* resource = std::pmr::get_default_resource(),
+                    CVText text = CVText::Copy)
+        : AbstractCV(key, help, resource, text), mLocal(defVal), mVal(&mLocal)
     {
-        std::shared_ptr<AbstractCV> p(new IntReadOnlyCV<IntType>(resolveVal(key, defVal), key, help));
-        return p;
     }
 
-    /// Make a read-only config value internally stored as a string
-    std::shared_ptr<AbstractCV>
-    Make_StrReadOnlyCV(const std::string& key, const std::string& defVal, const std::string& help)
-    {
-        std::shared_ptr<AbstractCV> p(new StrReadOnlyCV(resolveVal(key, defVal), key, help));
-        return p;
+    /// Return the value in its storage type.  Non-virtual for typed access.
+    bool value() const { return mVal->load(); }
+
+    virtual bool updatable() const override { return true; }
+    virtual CVKind kind() const override { return CVKind::Bool; }
+    virtual std::string asStr() const override { return value() ? "true" : "false"; }
+    virtual std::string_view asStrView(CVStrBuf&) const override { return value() ? "true" : "false"; }
+    virtual int64_t asInt() const override { return value(); }
+    virtual bool asBool() const override { return value(); }
+    virtual SetError prepare(std::string_view v, PreparedValue& out) const override {
+        return parseBool(v, out.b) ? SetError::None : SetError::InvalidValue;
+    }
+    virtual void commit(const PreparedValue& v) override {
+        *mVal = v.b;
+    }
+    virtual bool moveHotValue(void* line) override {
+        mVal = new (line) std::atomic<bool>(mLocal.load());
+        return true;
     }
+    /// Parses v strictly, as set() does, and throws std::invalid_argument
+    /// for anything that isn't a bool
+    virtual std::shared_ptr<AbstractCV> rebind(std::string_view v, std::pmr::memory_resource* resource) const override {
+        bool parsed;
+        if (!parseBool(v, parsed)) {
+            throwSetError(SetError::InvalidValue, v);
+        }
+        std::pmr::polymorphic_allocator<BoolUpdatableCV> alloc(resource);
+        return std::allocate_shared<BoolUpdatableCV>(alloc, parsed, key(), help(), resource, CVText::Static);
+    }
+};
 
-    /// Make a updatable config value internally stored as an integer
-    template <typename IntType>
-    std::shared_ptr<AbstractCV>
-    Make_IntUpdatableCV(const std::string& key, IntType defVal, const std::string& help)
+/**
+   Updatable string config value.
+
+   Each value is an immutable buffer holding the text and its integer and
+   bool views.  Readers load the current buffer with one atomic load and read
+   it without locking; set builds a new buffer and swaps the pointer.
+
+   Replaced buffers are kept until the config value is destroyed, so views
+   returned by value() and asStrView() stay valid for the config's lifetime,
+   as they do for StrReadOnlyCV.  Setting a value that was held before
+   reuses its buffer without allocating, so memory is bounded by the number
+   of distinct values set rather than the number of sets.  That bound still
+   grows: each new distinct value costs one buffer from the config's memory
+   resource until the config is destroyed, and with a ConfigArena until the
+   arena is released.
+
+   prepare() and commit() must be serialized with each other, as
+   ConfigTemplate does under its write lock, since prepare() reads the list
+   of buffers and allocates from a resource that need not be thread-safe.
+*/
+class StrUpdatableCV final : public AbstractCV {
+    /// One immutable value
+    struct Value {
+        Value(std::string_view v, std::pmr::memory_resource* resource)
+            : text(v, resource), boolVal(strToBool(v))
+        {
+            const char* end = text.data() + text.size();
+            auto res = std::from_chars(text.data(), end, intVal);
+            isInt = !text.empty() && res.ec == std::errc() && res.ptr == end;
+        }
+
+        std::pmr::string text;
+        int64_t intVal = 0;
+        bool isInt = false;
+        bool boolVal;
+        /// Value committed before this one.  Only touched by commit().
+        std::shared_ptr<Value> older;
+    };
+
+    /// Every value committed so far, newest first.  Owns the buffers.
+    std::shared_ptr<Value> mValues;
+    /// Inline storage for the current value, used until moveHotValue() is called
+    std::atomic<const Value*> mLocal;
+    /// Where the current value lives.  Either mLocal or a line in a HotValueBlock.
+    std::atomic<const Value*>* mVal;
+    std::pmr::memory_resource* mResource;
+
+    const Value& current() const { return *mVal->load(std::memory_order_acquire); }
+
+public:
+    using value_type = std::string_view;
+
+    StrUpdatableCV(std::string_view defVal, std::string_view key, std::string_view help,
+                   std::pmr::memory_resource* resource = std::pmr::get_default_resource(),
+                   CVText text = CVText::Copy)
+        : AbstractCV(key, help, resource, text)
+        , mValues(std::allocate_shared<Value>(std::pmr::polymorphic_allocator<Value>(resource), defVal, resource))
+        , mLocal(mValues.get()), mVal(&mLocal), mResource(resource)
     {
-        std::shared_ptr<AbstractCV> p(new IntUpdatableCV<IntType>(resolveVal(key, defVal), key, help));
-        return p;
     }
 
-    /// Make a read-only config value internally stored as a bool
-    std::shared_ptr<AbstractCV>
-    Make_BoolReadOnlyCV(const std::string& key, const bool defVal, const std::string& help)
+    ~StrUpdatableCV()
     {
-        std::shared_ptr<AbstractCV> p(new BoolReadOnlyCV(resolveVal(key, defVal), key, help));
-        return p;
+        // Unlink one at a time so a long history doesn't recurse
+        while (mValues) {
+            std::shared_ptr<Value> older = std::move(mValues->older);
+            mValues = std::move(older);
+        }
     }
 
-private:
-    /// Resolve the initial value for an integer config value
-    /// If override value exists, we'll use that otherwise use the default value passed in
-    template <typename IntType>
-    const IntType resolveVal(const std::string& overrideKey, const IntType defValue)
-    {
-        auto it = mOverrides.find(overrideKey);
-        if (it == mOverrides.end()) {
-            return defValue;
-        } else {
-            return std::stoi(it->second);
+    /// Return the value in its storage type.  Non-virtual for typed access.
+    std::string_view value() const { return current().text; }
+
+    virtual bool updatable() const override { return true; }
+    virtual bool hasInt() const override { return current().isInt; }
+    virtual CVKind kind() const override { return CVKind::Str; }
+    virtual std::string asStr() const override { return std::string(current().text); }
+    virtual std::string_view asStrView(CVStrBuf&) const override { return current().text; }
+    virtual int64_t asInt() const override {
+        const Value& val = current();
+        if (!val.isInt) {
+            throw std::invalid_argument("Config value is not an integer: " + std::string(key()));
+        }
+        return val.intVal;
+    }
+    virtual bool asBool() const override { return current().boolVal; }
+    virtual SetError prepare(std::string_view v, PreparedValue& out) const override {
+        for (const std::shared_ptr<Value>* old = &mValues; *old; old = &(*old)->older) {
+            if ((*old)->text == v) {
+                out.owned = *old;
+                return SetError::None;
+            }
+        }
+        out.owned = std::allocate_shared<Value>(std::pmr::polymorphic_allocator<Value>(mResource), v, mResource);
+        return SetError::None;
+    }
+    virtual void commit(const PreparedValue& v) override {
+        auto next = std::static_pointer_cast<Value>(v.owned);
+        for (Value* old = mValues.get(); old != nullptr; old = old->older.get()) {
+            if (old->text == next->text) {
+                mVal->store(old, std::memory_order_release);
+                return;
+            }
         }
+        next->older = std::move(mValues);
+        mValues = std::move(next);
+        mVal->store(mValues.get(), std::memory_order_release);
     }
+    virtual bool moveHotValue(void* line) override {
+        mVal = new (line) std::atomic<const Value*>(mLocal.load());
+        return true;
+    }
+    virtual std::shared_ptr<AbstractCV> rebind(std::string_view v, std::pmr::memory_resource* resource) const override {
+        std::pmr::polymorphic_allocator<StrUpdatableCV> alloc(resource);
+        return std::allocate_shared<StrUpdatableCV>(alloc, v, key(), help(), resource, CVText::Static);
+    }
+};
 
-    /// Resolve the initial value for an string config value
-    /// If override value exists, we'll use that otherwise use the default value passed in
-    const std::string& resolveVal(const std::string& overrideKey, const std::string& defValue)
-    {
-        auto it = mOverrides.find(overrideKey);
-        if (it == mOverrides.end()) {
-            return defValue;
-        } else {
-            return it->second;
+/**
+   Allowed names of an enumerated config value type.
+
+   Specialize for each C++ enum used with EnumReadOnlyCV, with a table of the
+   names and the enumerator each one maps to:
+
+       template <> struct ConfigEnumNames<FsType> {
+           static constexpr std::pair<std::string_view, FsType> names[] = {
+               { "alluxio", FsType::Alluxio }, { "hdfs", FsType::Hdfs } };
+       };
+
+   Names are matched case-insensitively.  The first name listed for an
+   enumerator is the one it renders as.
+*/
+template <typename EnumType>
+struct ConfigEnumNames;
+
+/// Look up the enumerator for a name
+/// @return false if the name is not in ConfigEnumNames<EnumType>
+template <typename EnumType>
+bool parseEnum(std::string_view name, EnumType& out) noexcept
+{
+    for (auto& n : ConfigEnumNames<EnumType>::names) {
+        if (strIEquals(name, n.first)) {
+            out = n.second;
+            return true;
         }
     }
+    return false;
+}
 
-    /// Resolve the initial value for bool config value
-    /// If override value exists, we'll use that otherwise use the default value passed in
-    bool resolveVal(const std::string& overrideKey, const bool defValue)
-    {
-        auto it = mOverrides.find(overrideKey);
-        if (it == mOverrides.end()) {
-            return defValue;
-        } else {
-            return strToBool(it->second);
+/// Return the name an enumerator renders as, or an empty view if it has none
+template <typename EnumType>
+std::string_view enumName(EnumType val) noexcept
+{
+    for (auto& n : ConfigEnumNames<EnumType>::names) {
+        if (n.second == val) {
+            return n.first;
         }
+    }
+    return {};
+}
 
+/// Parse an enumerated override or throw std::invalid_argument naming the key
+template <typename EnumType>
+EnumType strToEnum(std::string_view name, std::string_view key)
+{
+    EnumType val;
+    if (!parseEnum(name, val)) {
+        std::string allowed;
+        for (auto& n : ConfigEnumNames<EnumType>::names) {
+            allowed.append(allowed.empty() ? "" : ", ").append(n.first);
+        }
+        throw std::invalid_argument("Invalid value for " + std::string(key) + ": " + std::string(name)
+                                    + " (allowed: " + allowed + ")");
     }
-};
+    return val;
+}
+
+/// Unique address per C++ enum, returned by AbstractCV::enumTag()
+template <typename EnumType>
+inline constexpr char cvEnumTag = 0;
 
 /**
-   The template class to hold a set of config parameters.
+   Read-only config value that is one of a fixed set of names.
 
-   Each config parameter has an associated config value that you use to get/set
-   its value.
+   The name is resolved to a C++ enum once, when the value is made, and
+   overrides outside ConfigEnumNames<EnumType> are rejected then.  Reading the
+   value as EnumType (as_<EnumType>() or get<>()) involves no string compares;
+   reading it as a string returns its canonical name.  asInt() returns the
+   enumerator's underlying value.
+
+   Set throws an exception if called.
 */
-template <typename TConfigEnum>
-class ConfigTemplate
-{
-    /// Factory object that is used to create the AbstractCV subclass
-    CVFactory mFactory;
-    /// Map of config params and the AbstractCV to get/set their values
-    mutable std::map<TConfigEnum, std::shared_ptr<AbstractCV>> mParms;
+template <typename EnumType>
+class EnumReadOnlyCV final : public AbstractCV {
+    static_assert(std::is_enum<EnumType>::value, "Enum type expected");
+
+    EnumType mVal;
+    /// Canonical name of mVal, in static storage
+    std::string_view mName;
 
 public:
-    /// Constructor
-    /// Each instantiation of the template will use template specialization to
-    /// seed the mParms map.
-    ///
-    /// @param[in] overrides List of key/value pairs for specific config parms
-    ///            that are being overridden.  For each pair, it will override
-    ///            the hard-coded default.
-    ConfigTemplate(std::map<std::string, std::string> overrides);
+    using value_type = EnumType;
 
-    /// Get a config value as a specific type
-    /// @tparam T The type to get the value as.
-    /// @param[in] parm Config parm to lookup
-    template <typename T>
-    T as_(TConfigEnum parm) const {
-        auto& val = *(mParms[parm]);
-        T returnVal;
-        convertToType(val, returnVal);
-        return returnVal;
+    EnumReadOnlyCV(EnumType defVal, std::string_view key, std::string_view help,
+                   std::pmr::memory_resource* resource = std::pmr::get_default_resource(),
+                   CVText text = CVText::Copy)
+        : AbstractCV(key, help, resource, text), mVal(defVal), mName(enumName(defVal))
+    {
+        if (mName.empty()) {
+            throw std::invalid_argument("Value has no name in ConfigEnumNames: " + std::string(key));
+        }
     }
 
-    /// Set a config value
-    /// This will throw an exception if this used with a read-only config value
-    /// @param[in] parm Config parm to set
-    /// @param[in] newVal New value to set.
-    void set(TConfigEnum parm, const std::string& newVal) {
-        auto& val = *(mParms[parm]);
-        val.set(newVal);
-    }
+    /// Return the value in its storage type.  Non-virtual for typed access.
+    EnumType value() const { return mVal; }
 
-private:
-    /// Convert a config value to a string type
-    void convertToType(const AbstractCV& val, std::string& returnVal) const {
-        returnVal = val.asStr();
+    virtual CVKind kind() const override { return CVKind::Enum; }
+    virtual const void* enumTag() const override { return &cvEnumTag<EnumType>; }
+    virtual std::string asStr() const override { return std::string(mName); }
+    virtual std::string_view asStrView(CVStrBuf&) const override { return mName; }
+    virtual int64_t asInt() const override { return static_cast<int64_t>(mVal); }
+    virtual bool asBool() const override { return asInt() != 0; }
+    virtual std::shared_ptr<AbstractCV> rebind(std::string_view v, std::pmr::memory_resource* resource) const override {
+        std::pmr::polymorphic_allocator<EnumReadOnlyCV> alloc(resource);
+        return std::allocate_shared<EnumReadOnlyCV>(alloc, strToEnum<EnumType>(v, key()), key(), help(), resource, CVText::Static);
     }
+};
 
-    /// Convert a config value to an integer type
-    template <typename IntType>
-    void convertToType(const AbstractCV& val, IntType& returnVal) const {
-        returnVal = static_cast<IntType>(val.asInt());
-    }
+/// Convert a config value to a string type
+inline void convertToType(const AbstractCV& val, std::string& returnVal)
+{
+    returnVal = val.asStr();
+}
+
+/// Convert a config value to an integer type
+template <typename IntType, std::enable_if_t<!std::is_enum<IntType>::value, int> = 0>
+void convertToType(const AbstractCV& val, IntType& returnVal)
+{
+    returnVal = static_cast<IntType>(val.asInt());
+}
 
-    /// Convert a config value to a boolean type
-    void convertToType(const AbstractCV& val, bool& returnVal) const {
-        returnVal = val.asBool();
+/// Convert an enumerated config value to its C++ enum
+/// Throws std::invalid_argument if the value is not an EnumReadOnlyCV<EnumType>.
+template <typename EnumType, std::enable_if_t<std::is_enum<EnumType>::value, int> = 0>
+void convertToType(const AbstractCV& val, EnumType& returnVal)
+{
+    if (val.enumTag() != &cvEnumTag<EnumType>) {
+        throw std::invalid_argument("Config value is not of the requested enum type: " + std::string(val.key()));
     }
+    returnVal = static_cast<EnumType>(val.asInt());
+}
+
+/// Convert a config value to a boolean type
+inline void convertToType(const AbstractCV& val, bool& returnVal)
+{
+    returnVal = val.asBool();
+}
+
+/**
+   Perfect-hash index from string keys to small integer values.
+
+   Built once from a fixed set of keys.  Small key sets search for a single
+   seed that sends every key to its own bucket.  Larger sets use
+   hash-and-displace: keys are split into small groups by their hash, and a
+   displacement is searched per group, which keeps the build linear in the
+   number of keys.  A lookup is one string hash, two table loads and one key
+   compare, and never allocates.
+*/
+class KeyHashIndex {
+public:
+    /// Value returned by find() for keys that are not in the index
+    static constexpr uint32_t npos = UINT32_MAX;
+
+    KeyHashIndex() = default;
+
+    /// Constructor
+    /// Throws std::invalid_argument if a key appears more than once.
+    /// @param[in] entries Pairs of key and the value to map it to.  Keys must
+    ///            outlive the index.  Taken over without copying if they were
+    ///            allocated from resource.
+    /// @param[in] resource Memory resource for the index tables
+    explicit KeyHashIndex(std::pmr::vector<std::pair<std::string_view, uint32_t>> entries,
+                          std::pmr::memory_resource* resource = std::pmr::get_default_resource())
+        : mEntries(std::move(entries), resource), mDisp(resource), mBuckets(resource)
+    {
+        std::size_t buckets = 1;
+        while (buckets < mEntries.size() * 2) {
+            buckets <<= 1;
+        }
+        for (std::size_t grow = 0; mEntries.size() <= kMaxSeedKeys && grow < 3; ++grow) {
+            if (tryBuild(buckets << grow, 1, kMaxSeed)) {
+                return;
+            }
+        }
+        while (!tryBuild(buckets, buckets / 2, kMaxDisp)) {
+            buckets <<= 1;
+        }
+    }
+
+    /// Look up a key
+    /// @return The value mapped to the key, or npos if it is not in the index
+    uint32_t find(std::string_view key) const noexcept {
+        if (mEntries.empty()) {
+            return npos;
+        }
+        uint64_t h = hash(key);
+        uint32_t slot = mBuckets[bucket(h, mDisp[h & mGroupMask])];
+        if (slot == npos || mEntries[slot].first != key) {
+            return npos;
+        }
+        return mEntries[slot].second;
+    }
+
+private:
+    /// Largest key set that first tries a single seed.  Beyond this a
+    /// collision-free seed is too unlikely to be worth searching for.
+    static constexpr std::size_t kMaxSeedKeys = 32;
+    /// Number of seeds tried for a single group table of a given size
+    static constexpr uint32_t kMaxSeed = 64;
+    /// Largest displacement tried for a group before growing the table
+    static constexpr uint32_t kMaxDisp = 1u << 16;
+
+    /// FNV-1a hash of a key
+    static uint64_t hash(std::string_view key) noexcept {
+        uint64_t h = 14695981039346656037ULL;
+        for (char c : key) {
+            h ^= static_cast<unsigned char>(c);
+            h *= 1099511628211ULL;
+        }
+        return h;
+    }
+
+    /// Mix a key hash with its group's displacement into a bucket number
+    std::size_t bucket(uint64_t h, uint32_t disp) const noexcept {
+        h += (disp + 1) * 0x9E3779B97F4A7C15ULL;
+        h = (h ^ (h >> 30)) * 0xBF58476D1CE4E5B9ULL;
+        h = (h ^ (h >> 27)) * 0x94D049BB133111EBULL;
+        return static_cast<std::size_t>(h ^ (h >> 31)) & mMask;
+    }
+
+    /// Search for a displacement per group that places every key in its own
+    /// bucket, placing the largest groups first.  With one group the
+    /// displacement is just a seed for the whole table.
+    /// Throws std::invalid_argument for duplicate keys, which are only caught
+    /// in the grouped mode; a single seed just never separates them.
+    /// @return false if some group could not be placed
+    bool tryBuild(std::size_t buckets, std::size_t groups, uint32_t maxDisp) {
+        const uint32_t n = static_cast<uint32_t>(mEntries.size());
+        mMask = buckets - 1;
+        mGroupMask = groups - 1;
+        mBuckets.assign(buckets, npos);
+        mDisp.assign(groups, 0);
+
+        // Scratch tables live on the stack unless the key set is large
+        alignas(std::max_align_t) unsigned char buf[4096];
+        std::pmr::monotonic_buffer_resource scratch(buf, sizeof(buf));
+        std::pmr::vector<uint64_t> hashes(n, &scratch);
+        for (uint32_t i = 0; i < n; ++i) {
+            hashes[i] = hash(mEntries[i].first);
+        }
+
+        // Bucket the entries by group with a counting sort, so members of a
+        // group are contiguous in byGroup starting at start[g]
+        std::pmr::vector<uint32_t> byGroup(n, &scratch);
+        std::pmr::vector<uint32_t> start(groups + 1, 0, &scratch);
+        std::pmr::vector<uint32_t> order(&scratch);
+        if (groups == 1) {
+            for (uint32_t i = 0; i < n; ++i) {
+                byGroup[i] = i;
+            }
+            start[1] = n;
+            order.push_back(0);
+        } else {
+            for (uint32_t i = 0; i < n; ++i) {
+                ++start[(hashes[i] & mGroupMask) + 1];
+            }
+            order.reserve(std::min<std::size_t>(groups, n));
+            for (uint32_t g = 0; g < groups; ++g) {
+                if (start[g + 1] != 0) {
+                    order.push_back(g);
+                }
+                start[g + 1] += start[g];
+            }
+            std::pmr::vector<uint32_t> fill(start.begin(), start.end() - 1, &scratch);
+            for (uint32_t i = 0; i < n; ++i) {
+                byGroup[fill[hashes[i] & mGroupMask]++] = i;
+            }
+            std::sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) {
+                uint32_t sizeA = start[a + 1] - start[a];
+                uint32_t sizeB = start[b + 1] - start[b];
+                return sizeA != sizeB ? sizeA > sizeB : a < b;
+            });
+        }
+
+        for (uint32_t g : order) {
+            const uint32_t* first = byGroup.data() + start[g];
+            const uint32_t* last = byGroup.data() + start[g + 1];
+            if (groups > 1) {
+                rejectDuplicates(first, last);
+            }
+            uint32_t disp = 0;
+            while (!place(first, last, hashes, disp)) {
+                if (++disp == maxDisp) {
+                    return false;
+                }
+            }
+            mDisp[g] = disp;
+        }
+        return true;
+    }
+
+    /// Claim a free bucket for each key of a group, or claim none
+    /// @return false if two keys collide or a bucket is taken
+    bool place(const uint32_t* first, const uint32_t* last, const std::pmr::vector<uint64_t>& hashes, uint32_t disp) {
+        for (const uint32_t* i = first; i != last; ++i) {
+            uint32_t& slot = mBuckets[bucket(hashes[*i], disp)];
+            if (slot != npos) {
+                for (const uint32_t* j = first; j != i; ++j) {
+                    mBuckets[bucket(hashes[*j], disp)] = npos;
+                }
+                return false;
+            }
+            slot = *i;
+        }
+        return true;
+    }
+
+    /// Throw if a group holds the same key twice, since no displacement could
+    /// separate them
+    void rejectDuplicates(const uint32_t* first, const uint32_t* last) const {
+        for (const uint32_t* a = first; a != last; ++a) {
+            for (const uint32_t* b = a + 1; b != last; ++b) {
+                if (mEntries[*a].first == mEntries[*b].first) {
+                    throw std::invalid_argument("Duplicate config key: " + std::string(mEntries[*a].first));
+                }
+            }
+        }
+    }
+
+    std::pmr::vector<std::pair<std::string_view, uint32_t>> mEntries;
+    /// Displacement for each group of keys
+    std::pmr::vector<uint32_t> mDisp;
+    /// Index into mEntries for each bucket, or npos
+    std::pmr::vector<uint32_t> mBuckets;
+    std::size_t mMask = 0;
+    std::size_t mGroupMask = 0;
+};
+
+/**
+   Hashed view of key/value override pairs.
+
+   Holds views into the strings of the source it is built from, so the source
+   must outlive it.  Pass the memory resource of the config it is for, e.g. a
+   ConfigArena's, to keep building the config off the default heap.
+*/
+class ConfigOverrides {
+    std::pmr::vector<std::string_view> mValues;
+    KeyHashIndex mIndex;
+
+public:
+    /// Constructor
+    /// @param[in] overrides Pairs of key/value that override specific config values.
+    /// @param[in] resource Memory resource for the hash index
+    ConfigOverrides(const std::map<std::string, std::string>& overrides,
+                    std::pmr::memory_resource* resource = std::pmr::get_default_resource())
+        : ConfigOverrides(overrides.begin(), overrides.end(), resource)
+    {
+    }
+
+    /// Constructor
+    /// @param[in] overrides Pairs of key/value views, e.g. from a ConfigSource.
+    /// @param[in] resource Memory resource for the hash index
+    ConfigOverrides(const std::vector<std::pair<std::string_view, std::string_view>>& overrides,
+                    std::pmr::memory_resource* resource = std::pmr::get_default_resource())
+        : ConfigOverrides(overrides.begin(), overrides.end(), resource)
+    {
+    }
+
+    /// Constructor for brace-initialized pairs, e.g. {{"KEY", "value"}}
+    ConfigOverrides(std::initializer_list<std::pair<std::string_view, std::string_view>> overrides,
+                    std::pmr::memory_resource* resource = std::pmr::get_default_resource())
+        : ConfigOverrides(overrides.begin(), overrides.end(), resource)
+    {
+    }
+
+    /// Look up the override value for a key
+    /// @return The value or nullptr if the key is not overridden
+    const std::string_view* find(std::string_view key) const noexcept {
+        uint32_t idx = mIndex.find(key);
+        return idx == KeyHashIndex::npos ? nullptr : &mValues[idx];
+    }
+
+private:
+    template <typename It>
+    ConfigOverrides(It first, It last, std::pmr::memory_resource* resource)
+        : mValues(resource), mIndex(split(first, last, mValues, resource), resource)
+    {
+    }
+
+    /// Copy the values of a range of pairs into values and return the keys
+    /// with their positions, to index
+    template <typename It>
+    static std::pmr::vector<std::pair<std::string_view, uint32_t>> split(
+        It first, It last, std::pmr::vector<std::string_view>& values, std::pmr::memory_resource* resource) {
+        std::size_t n = static_cast<std::size_t>(std::distance(first, last));
+        std::pmr::vector<std::pair<std::string_view, uint32_t>> entries(resource);
+        entries.reserve(n);
+        values.reserve(n);
+        for (; first != last; ++first) {
+            entries.emplace_back(first->first, static_cast<uint32_t>(values.size()));
+            values.emplace_back(first->second);
+        }
+        return entries;
+    }
+};
+
+class CVFactory;
+
+/**
+   Compile-time declaration of one config parm.
+
+   A ConfigRegistry holds a constexpr table of these.  The key, help text and
+   default live in read-only static storage, and the config values built from
+   them only keep views of the text.  Use the *Parm() helpers below to build
+   the entries.
+*/
+template <typename TConfigEnum>
+struct ParmDef {
+    TConfigEnum parm;
+    std::string_view key;
+    CVKind kind;
+    bool updatable;
+    /// Default for integer, bool and enumerated parms
+    int64_t intDefault;
+    /// Default for string parms
+    std::string_view strDefault;
+    std::string_view help;
+    /// Makes the value of an enumerated parm, which needs its C++ enum type
+    std::shared_ptr<AbstractCV> (*makeEnum)(CVFactory&, const ParmDef&) = nullptr;
+    /// Checks on the value of an integer parm.  Never null, so the registry
+    /// checks can call it at compile time; &AllOf<>::check means none.
+    IntCheck check = &AllOf<>::check;
+    /// Unit suffixes an integer parm accepts
+    IntUnit unit = IntUnit::None;
+};
+
+template <typename EnumType, typename TConfigEnum>
+std::shared_ptr<AbstractCV> makeEnumParm(CVFactory& factory, const ParmDef<TConfigEnum>& def);
+
+/// Declare a read-only integer parm, e.g. intParm<int16_t, InRange<1, 4096>>(...)
+/// The default is taken at full width so the registry checks can tell if it
+/// doesn't fit IntType or fails Checks.
+/// @tparam Checks Checks on the value (see IntCheck)
+/// @param[in] unit Unit suffixes the value accepts, e.g. IntUnit::Size for "4GB"
+template <typename IntType, typename... Checks, typename TConfigEnum>
+constexpr ParmDef<TConfigEnum> intParm(TConfigEnum parm, std::string_view key, int64_t defVal, std::string_view help,
+                                       IntUnit unit = IntUnit::None)
+{
+    static_assert(std::is_signed<IntType>::value, "Registry integer parms must use a signed integer type");
+    return { parm, key, cvKindOf<IntType>(), false, defVal, {}, help, nullptr, &AllOf<Checks...>::check, unit };
+}
+
+/// Declare an updatable integer parm
+/// @tparam Checks Checks each new value must pass (see IntCheck)
+/// @param[in] unit Unit suffixes the value accepts
+template <typename IntType, typename... Checks, typename TConfigEnum>
+constexpr ParmDef<TConfigEnum> updatableIntParm(TConfigEnum parm, std::string_view key, int64_t defVal, std::string_view help,
+                                                IntUnit unit = IntUnit::None)
+{
+    static_assert(std::is_signed<IntType>::value, "Registry integer parms must use a signed integer type");
+    return { parm, key, cvKindOf<IntType>(), true, defVal, {}, help, nullptr, &AllOf<Checks...>::check, unit };
+}
+
+/// Declare a read-only bool parm
+template <typename TConfigEnum>
+constexpr ParmDef<TConfigEnum> boolParm(TConfigEnum parm, std::string_view key, bool defVal, std::string_view help)
+{
+    return { parm, key, CVKind::Bool, false, defVal, {}, help };
+}
+
+/// Declare a read-only string parm
+template <typename TConfigEnum>
+constexpr ParmDef<TConfigEnum> strParm(TConfigEnum parm, std::string_view key, std::string_view defVal, std::string_view help)
+{
+    return { parm, key, CVKind::Str, false, 0, defVal, help };
+}
+
+/// Declare an updatable bool parm
+template <typename TConfigEnum>
+constexpr ParmDef<TConfigEnum> updatableBoolParm(TConfigEnum parm, std::string_view key, bool defVal, std::string_view help)
+{
+    return { parm, key, CVKind::Bool, true, defVal, {}, help };
+}
+
+/// Declare an updatable string parm
+template <typename TConfigEnum>
+constexpr ParmDef<TConfigEnum> updatableStrParm(TConfigEnum parm, std::string_view key, std::string_view defVal, std::string_view help)
+{
+    return { parm, key, CVKind::Str, true, 0, defVal, help };
+}
+
+/// Declare a read-only enumerated parm (see EnumReadOnlyCV)
+/// Specialize ConfigParmTraits for the parm to read it with get<>().
+template <typename EnumType, typename TConfigEnum>
+constexpr ParmDef<TConfigEnum> enumParm(TConfigEnum parm, std::string_view key, EnumType defVal, std::string_view help)
+{
+    return { parm, key, CVKind::Enum, false, static_cast<int64_t>(defVal), {}, help, &makeEnumParm<EnumType, TConfigEnum> };
+}
+
+/**
+   Compile-time table of the parms in a config enum.
+
+   Specialize with a static constexpr parms[] array of ParmDef entries.  A
+   ConfigTemplate whose enum has a registry needs no constructor
+   specialization; it builds its values straight from the table.
+*/
+template <typename TConfigEnum>
+struct ConfigRegistry;
+
+/**
+   Factory class that generates config values
+
+   Handles picking of the initial value by using the hard-coded default and the
+   value defined in a map.  A factory only lives while a config is being
+   constructed; it refers to the overrides rather than copying them, and the
+   config values it makes copy whatever they keep.
+*/
+class CVFactory
+{
+    /// Key/value pairs of override values.  The key names are the config value
+    /// parameter names.  If a value is missing from this map, then we will
+    /// just use the hard coded default value.
+    const ConfigOverrides& mOverrides;
+    /// Memory resource the config values are allocated from
+    std::pmr::memory_resource* mResource;
+
+public:
+    /// Constructor
+    /// @param[in] override Pairs of key/value that override specific config
+    ///            values.  Must outlive the factory.
+    /// @param[in] resource Memory resource to allocate the config values from
+    explicit CVFactory(const ConfigOverrides& overrides,
+                       std::pmr::memory_resource* resource = std::pmr::get_default_resource())
+        : mOverrides(overrides), mResource(resource)
+    {
+    }
+
+    // A temporary would be gone before the factory is used
+    CVFactory(const ConfigOverrides&&, std::pmr::memory_resource* = nullptr) = delete;
+
+    CVFactory(const CVFactory&) = delete;
+    CVFactory& operator=(const CVFactory&) = delete;
+
+    /// Make a read-only config value internally stored as an integer
+    /// Throws std::out_of_range if the default doesn't fit IntType, or if the
+    /// default or override fails check.
+    /// @param[in] check Checks on the value, e.g. intCheck<AtLeast<1>>()
+    /// @param[in] unit Unit suffixes the override may use
+    template <typename IntType, typename DefType = IntType>
+    std::shared_ptr<AbstractCV>
+    Make_IntReadOnlyCV(std::string_view key, DefType defVal, std::string_view help, IntCheck check = nullptr,
+                       IntUnit unit = IntUnit::None)
+    {
+        return make<IntReadOnlyCV<IntType>>(resolveVal(key, checkedDefault<IntType>(key, defVal), unit), key, help,
+                                            CVText::Copy, check, unit);
+    }
+
+    /// Make a read-only config value internally stored as a string
+    std::shared_ptr<AbstractCV>
+    Make_StrReadOnlyCV(std::string_view key, std::string_view defVal, std::string_view help)
+    {
+        return make<StrReadOnlyCV>(resolveVal(key, defVal), key, help);
+    }
+
+    /// Make a updatable config value internally stored as an integer
+    /// Throws std::out_of_range if the default doesn't fit IntType, or if the
+    /// default or override fails check.
+    /// @param[in] check Checks each value must pass, e.g. intCheck<AtLeast<0>>()
+    /// @param[in] unit Unit suffixes the override and new values may use
+    template <typename IntType, typename DefType = IntType>
+    std::shared_ptr<AbstractCV>
+    Make_IntUpdatableCV(std::string_view key, DefType defVal, std::string_view help, IntCheck check = nullptr,
+                        IntUnit unit = IntUnit::None)
+    {
+        return make<IntUpdatableCV<IntType>>(resolveVal(key, checkedDefault<IntType>(key, defVal), unit), key, help,
+                                             CVText::Copy, check, unit);
+    }
+
+    /// Make a read-only config value internally stored as a bool
+    std::shared_ptr<AbstractCV>
+    Make_BoolReadOnlyCV(std::string_view key, const bool defVal, std::string_view help)
+    {
+        return make<BoolReadOnlyCV>(resolveVal(key, defVal), key, help);
+    }
+
+    /// Make a updatable config value internally stored as a string
+    std::shared_ptr<AbstractCV>
+    Make_StrUpdatableCV(std::string_view key, std::string_view defVal, std::string_view help)
+    {
+        return make<StrUpdatableCV>(resolveVal(key, defVal), key, help);
+    }
+
+    /// Make a updatable config value internally stored as a bool
+    std::shared_ptr<AbstractCV>
+    Make_BoolUpdatableCV(std::string_view key, const bool defVal, std::string_view help)
+    {
+        return make<BoolUpdatableCV>(resolveVal(key, defVal), key, help);
+    }
+
+    /// Make a read-only config value that is one of the names in
+    /// ConfigEnumNames<EnumType>
+    /// Throws std::invalid_argument if the override is not one of the names.
+    template <typename EnumType>
+    std::shared_ptr<AbstractCV>
+    Make_EnumReadOnlyCV(std::string_view key, EnumType defVal, std::string_view help, CVText text = CVText::Copy)
+    {
+        return make<EnumReadOnlyCV<EnumType>>(resolveVal(key, defVal), key, help, text);
+    }
+
+    /// Make a config value from its registry declaration.
+    /// The key and help text are not copied.
+    template <typename TConfigEnum>
+    std::shared_ptr<AbstractCV>
+    Make(const ParmDef<TConfigEnum>& def)
+    {
+        switch (def.kind) {
+        case CVKind::Int8: return makeInt<int8_t>(def);
+        case CVKind::Int16: return makeInt<int16_t>(def);
+        case CVKind::Int32: return makeInt<int32_t>(def);
+        case CVKind::Int64: return makeInt<int64_t>(def);
+        case CVKind::Bool:
+            if (def.updatable) {
+                return make<BoolUpdatableCV>(resolveVal(def.key, def.intDefault != 0), def.key, def.help, CVText::Static);
+            }
+            return make<BoolReadOnlyCV>(resolveVal(def.key, def.intDefault != 0), def.key, def.help, CVText::Static);
+        case CVKind::Str:
+            if (def.updatable) {
+                return make<StrUpdatableCV>(resolveVal(def.key, def.strDefault), def.key, def.help, CVText::Static);
+            }
+            return make<StrReadOnlyCV>(resolveVal(def.key, def.strDefault), def.key, def.help, CVText::Static);
+        case CVKind::Enum:
+            if (!def.updatable && def.makeEnum != nullptr) {
+                return def.makeEnum(*this, def);
+            }
+            break;
+        }
+        throw std::invalid_argument("Unsupported config value type: " + std::string(def.key));
+    }
+
+    /// Return the memory resource config values are allocated from
+    std::pmr::memory_resource* resource() const { return mResource; }
+
+private:
+    /// Allocate a config value and its control block from the memory resource
+    /// @param[in] extra Trailing constructor arguments of the value, if any
+    template <typename CV, typename ValType, typename... Extra>
+    std::shared_ptr<AbstractCV> make(ValType val, std::string_view key, std::string_view help,
+                                     CVText text = CVText::Copy, Extra... extra)
+    {
+        return std::allocate_shared<CV>(std::pmr::polymorphic_allocator<CV>(mResource), val, key, help, mResource, text,
+                                        extra...);
+    }
+
+    /// Narrow a hard-coded default to its storage type, rejecting one that
+    /// would change value
+    template <typename IntType, typename DefType>
+    static IntType checkedDefault(std::string_view key, DefType defVal)
+    {
+        if (!intFits<IntType>(defVal)) {
+            throw std::out_of_range("Default out of range for " + std::string(key) + ": " + std::to_string(defVal));
+        }
+        return static_cast<IntType>(defVal);
+    }
+
+    /// Make an integer config value from its registry declaration
+    template <typename IntType, typename TConfigEnum>
+    std::shared_ptr<AbstractCV> makeInt(const ParmDef<TConfigEnum>& def)
+    {
+        IntType val = resolveVal(def.key, static_cast<IntType>(def.intDefault), def.unit);
+        IntCheck check = def.check == &AllOf<>::check ? nullptr : def.check;
+        if (def.updatable) {
+            return make<IntUpdatableCV<IntType>>(val, def.key, def.help, CVText::Static, check, def.unit);
+        }
+        return make<IntReadOnlyCV<IntType>>(val, def.key, def.help, CVText::Static, check, def.unit);
+    }
+
+    /// Resolve the initial value for an enumerated config value
+    /// If override value exists, we'll use that otherwise use the default value passed in
+    template <typename EnumType, std::enable_if_t<std::is_enum<EnumType>::value, int> = 0>
+    EnumType resolveVal(std::string_view overrideKey, EnumType defValue)
+    {
+        auto it = mOverrides.find(overrideKey);
+        return it == nullptr ? defValue : strToEnum<EnumType>(*it, overrideKey);
+    }
+
+    /// Resolve the initial value for an integer config value
+    /// If override value exists, we'll use that otherwise use the default value passed in
+    /// @param[in] unit Unit suffixes the override may use
+    template <typename IntType, std::enable_if_t<!std::is_enum<IntType>::value, int> = 0>
+    const IntType resolveVal(std::string_view overrideKey, const IntType defValue, IntUnit unit = IntUnit::None)
+    {
+        auto it = mOverrides.find(overrideKey);
+        if (it == nullptr) {
+            return defValue;
+        } else {
+            return strToInt<IntType>(*it, unit);
+        }
+    }
+
+    /// Resolve the initial value for an string config value
+    /// If override value exists, we'll use that otherwise use the default value passed in
+    std::string_view resolveVal(std::string_view overrideKey, std::string_view defValue)
+    {
+        auto it = mOverrides.find(overrideKey);
+        if (it == nullptr) {
+            return defValue;
+        } else {
+            return *it;
+        }
+    }
+
+    /// Resolve the initial value for bool config value
+    /// If override value exists, we'll use that otherwise use the default value passed in
+    bool resolveVal(std::string_view overrideKey, const bool defValue)
+    {
+        auto it = mOverrides.find(overrideKey);
+        if (it == nullptr) {
+            return defValue;
+        } else {
+            return strToBool(*it);
+        }
+
+    }
+};
+
+/// Make an enumerated registry parm.  Used by enumParm().
+template <typename EnumType, typename TConfigEnum>
+std::shared_ptr<AbstractCV> makeEnumParm(CVFactory& factory, const ParmDef<TConfigEnum>& def)
+{
+    return factory.Make_EnumReadOnlyCV(def.key, static_cast<EnumType>(def.intDefault), def.help, CVText::Static);
+}
+
+/**
+   Number of parameters in a config enum.
+
+   By default the enum is expected to end with a COUNT sentinel.  Specialize
+   this trait for enums that cannot carry a sentinel.
+*/
+template <typename TConfigEnum>
+struct ConfigEnumCount {
+    static constexpr std::size_t value = static_cast<std::size_t>(TConfigEnum::COUNT);
+};
+
+/**
+   Option to pad updatable config values.
+
+   When true, ConfigTemplate moves every updatable value onto its own cache
+   line in one contiguous block, away from the key and help text, so a
+   frequently set value doesn't slow down readers of its neighbours.
+   Specialize to std::true_type to enable it for a config enum.
+*/
+template <typename TConfigEnum>
+struct ConfigPadUpdatable : std::false_type {
+};
+
+/// Convert a config enum to its slot index
+template <typename TConfigEnum>
+constexpr std::size_t enumIndex(TConfigEnum parm)
+{
+    return static_cast<std::size_t>(parm);
+}
+
+/**
+   Fixed-size array indexed directly by a dense config enum.
+
+   A lookup is a single indexed load.  It can be brace-initialized with
+   {enum, value} pairs so that the ConfigTemplate specializations seed it the
+   same way they would seed a map.
+*/
+template <typename TConfigEnum, typename T>
+class EnumIndexedArray {
+public:
+    using enum_type = TConfigEnum;
+    static constexpr std::size_t size = ConfigEnumCount<TConfigEnum>::value;
+
+    EnumIndexedArray() = default;
+
+    /// Constructor
+    /// @param[in] init Pairs of enum/value to place in their slots
+    /// Throws std::logic_error if an enum appears twice.
+    EnumIndexedArray(std::initializer_list<std::pair<TConfigEnum, T>> init)
+    {
+        std::array<bool, size> seen{};
+        for (auto& p : init) {
+            std::size_t idx = enumIndex(p.first);
+            if (idx < size && seen[idx]) {
+                throw std::logic_error("Config parm registered twice: " + std::to_string(idx));
+            }
+            mSlots.at(idx) = p.second;
+            seen[idx] = true;
+        }
+    }
+
+    const T& operator[](TConfigEnum parm) const { return mSlots[enumIndex(parm)]; }
+    T& operator[](TConfigEnum parm) { return mSlots[enumIndex(parm)]; }
+
+    /// Bounds checked access.  Throws std::out_of_range.
+    T& at(TConfigEnum parm) { return mSlots.at(enumIndex(parm)); }
+
+    /// Return true if the enum maps to a slot in the array
+    static constexpr bool inRange(TConfigEnum parm) { return enumIndex(parm) < size; }
+
+private:
+    std::array<T, size> mSlots{};
+};
+
+/**
+   Contiguous block of cache lines that holds the updatable config values.
+
+   Each updatable value gets a line to itself.  The AbstractCV objects keep
+   their cold metadata (key, help) and point at their line.
+*/
+class HotValueBlock {
+    struct alignas(kCacheLineSize) CacheLine {
+        unsigned char bytes[kCacheLineSize];
+    };
+
+    CacheLine* mLines = nullptr;
+    std::size_t mCount = 0;
+    std::pmr::memory_resource* mResource;
+
+public:
+    /// Constructor
+    /// @param[in] parms Config values to move into the block
+    /// @param[in] enabled If false, the values are left where they are
+    /// @param[in] resource Memory resource to allocate the block from
+    template <typename TParms>
+    HotValueBlock(TParms& parms, bool enabled, std::pmr::memory_resource* resource)
+        : mResource(resource)
+    {
+        if (!enabled) {
+            return;
+        }
+        for (std::size_t i = 0; i < parms.size; ++i) {
+            auto& val = parms[static_cast<typename TParms::enum_type>(i)];
+            if (val && val->updatable()) {
+                ++mCount;
+            }
+        }
+        if (mCount == 0) {
+            return;
+        }
+        mLines = static_cast<CacheLine*>(mResource->allocate(mCount * sizeof(CacheLine), alignof(CacheLine)));
+        std::size_t used = 0;
+        for (std::size_t i = 0; i < parms.size; ++i) {
+            auto& val = parms[static_cast<typename TParms::enum_type>(i)];
+            if (val && val->updatable() && val->moveHotValue(&mLines[used])) {
+                ++used;
+            }
+        }
+    }
+
+    HotValueBlock(HotValueBlock&& other) noexcept
+        : mLines(other.mLines), mCount(other.mCount), mResource(other.mResource)
+    {
+        other.mLines = nullptr;
+        other.mCount = 0;
+    }
+
+    HotValueBlock(const HotValueBlock&) = delete;
+    HotValueBlock& operator=(const HotValueBlock&) = delete;
+
+    ~HotValueBlock()
+    {
+        if (mLines != nullptr) {
+            mResource->deallocate(mLines, mCount * sizeof(CacheLine), alignof(CacheLine));
+        }
+    }
+};
+
+/// Map a registry storage kind and mutability to the AbstractCV subclass
+template <CVKind Kind, bool Updatable>
+struct CVClassFor;
+template <> struct CVClassFor<CVKind::Int8, false> { using type = IntReadOnlyCV<int8_t>; };
+template <> struct CVClassFor<CVKind::Int16, false> { using type = IntReadOnlyCV<int16_t>; };
+template <> struct CVClassFor<CVKind::Int32, false> { using type = IntReadOnlyCV<int32_t>; };
+template <> struct CVClassFor<CVKind::Int64, false> { using type = IntReadOnlyCV<int64_t>; };
+template <> struct CVClassFor<CVKind::Int8, true> { using type = IntUpdatableCV<int8_t>; };
+template <> struct CVClassFor<CVKind::Int16, true> { using type = IntUpdatableCV<int16_t>; };
+template <> struct CVClassFor<CVKind::Int32, true> { using type = IntUpdatableCV<int32_t>; };
+template <> struct CVClassFor<CVKind::Int64, true> { using type = IntUpdatableCV<int64_t>; };
+template <> struct CVClassFor<CVKind::Bool, false> { using type = BoolReadOnlyCV; };
+template <> struct CVClassFor<CVKind::Bool, true> { using type = BoolUpdatableCV; };
+template <> struct CVClassFor<CVKind::Str, false> { using type = StrReadOnlyCV; };
+template <> struct CVClassFor<CVKind::Str, true> { using type = StrUpdatableCV; };
+
+/// Find the registry entry for a parm.  Returns the table size if missing.
+template <typename TConfigEnum>
+constexpr std::size_t registryIndex(TConfigEnum parm)
+{
+    const auto& parms = ConfigRegistry<TConfigEnum>::parms;
+    std::size_t i = 0;
+    while (i < std::size(parms) && parms[i].parm != parm) {
+        ++i;
+    }
+    return i;
+}
+
+/// Return true if every enum value has exactly one registry entry
+template <typename TConfigEnum>
+constexpr bool registryComplete()
+{
+    constexpr std::size_t kCount = ConfigEnumCount<TConfigEnum>::value;
+    const auto& parms = ConfigRegistry<TConfigEnum>::parms;
+    if (std::size(parms) != kCount) {
+        return false;
+    }
+    bool seen[kCount] = {};
+    for (const auto& def : parms) {
+        std::size_t idx = enumIndex(def.parm);
+        if (idx >= kCount || seen[idx]) {
+            return false;
+        }
+        seen[idx] = true;
+    }
+    return true;
+}
+
+/// Return true if every registry key is non-empty and used once.
+/// Sorts a copy of the keys (heapsort, as std::sort isn't constexpr in
+/// C++17) so large tables stay within the compiler's constexpr budget.
+template <typename TConfigEnum>
+constexpr bool registryKeysUnique()
+{
+    const auto& parms = ConfigRegistry<TConfigEnum>::parms;
+    constexpr std::size_t kSize = std::size(ConfigRegistry<TConfigEnum>::parms);
+    std::array<std::string_view, kSize> keys{};
+    for (std::size_t i = 0; i < kSize; ++i) {
+        if (parms[i].key.empty()) {
+            return false;
+        }
+        keys[i] = parms[i].key;
+    }
+    auto siftDown = [&keys](std::size_t root, std::size_t end) {
+        while (2 * root + 1 < end) {
+            std::size_t child = 2 * root + 1;
+            if (child + 1 < end && keys[child] < keys[child + 1]) {
+                ++child;
+            }
+            if (!(keys[root] < keys[child])) {
+                return;
+            }
+            std::string_view tmp = keys[root];
+            keys[root] = keys[child];
+            keys[child] = tmp;
+            root = child;
+        }
+    };
+    for (std::size_t i = kSize / 2; i > 0; --i) {
+        siftDown(i - 1, kSize);
+    }
+    for (std::size_t end = kSize; end > 1; --end) {
+        std::string_view tmp = keys[0];
+        keys[0] = keys[end - 1];
+        keys[end - 1] = tmp;
+        siftDown(0, end - 1);
+    }
+    for (std::size_t i = 1; i < kSize; ++i) {
+        if (keys[i - 1] == keys[i]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/// Return true if every integer default fits the parm's storage type
+template <typename TConfigEnum>
+constexpr bool registryDefaultsFit()
+{
+    for (const auto& def : ConfigRegistry<TConfigEnum>::parms) {
+        bool fits = true;
+        switch (def.kind) {
+        case CVKind::Int8: fits = intFits<int8_t>(def.intDefault); break;
+        case CVKind::Int16: fits = intFits<int16_t>(def.intDefault); break;
+        case CVKind::Int32: fits = intFits<int32_t>(def.intDefault); break;
+        default: break;
+        }
+        if (!fits) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/// Return true if every integer default passes the parm's checks
+template <typename TConfigEnum>
+constexpr bool registryDefaultsPassChecks()
+{
+    for (const auto& def : ConfigRegistry<TConfigEnum>::parms) {
+        if (!def.check(def.intDefault)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+   Compile-time binding of a config parm to the AbstractCV subclass that
+   stores it.
+
+   For enums with a ConfigRegistry this is derived from the table.  Otherwise
+   specialize it for each parm that is read through ConfigTemplate::get<>().
+   The specialization must define CVType to the exact class the factory makes
+   for that parm, e.g. IntReadOnlyCV<int16_t>.
+*/
+template <typename TConfigEnum, TConfigEnum Parm>
+struct ConfigParmTraits {
+private:
+    static constexpr std::size_t kIdx = registryIndex(Parm);
+    static_assert(kIdx < std::size(ConfigRegistry<TConfigEnum>::parms), "Config parm is not in the registry");
+    static constexpr const ParmDef<TConfigEnum>& kDef = ConfigRegistry<TConfigEnum>::parms[kIdx];
+
+public:
+    using CVType = typename CVClassFor<kDef.kind, kDef.updatable>::type;
+};
+
+/**
+   Values a ConfigConstraint is checked against.
+
+   Reads the config's current values, with the update being checked applied
+   on top, so a constraint sees what the config would hold after the update.
+   The current values can also come from a layer of overrides on a config,
+   e.g. a LayeredConfig, through a find function.
+*/
+template <typename TConfigEnum>
+class PendingConfig
+{
+public:
+    using Parms = EnumIndexedArray<TConfigEnum, std::shared_ptr<AbstractCV>>;
+    /// One prepared update.  The value's s field holds the text it came from.
+    using Update = std::pair<TConfigEnum, const PreparedValue*>;
+    /// Return the current value of a parm in source, or nullptr if unknown
+    using FindFn = const AbstractCV* (*)(const void* source, TConfigEnum parm);
+
+    /// Constructor
+    /// @param[in] parms Current config values
+    /// @param[in] updates Updates to apply on top of them
+    /// @param[in] count Number of updates
+    PendingConfig(const Parms& parms, const Update* updates, std::size_t count)
+        : mSource(&parms), mFind(&findParm), mUpdates(updates), mCount(count)
+    {
+    }
+
+    /// Constructor for values held outside a ConfigTemplate
+    /// @param[in] source Values to read, passed to find
+    /// @param[in] find Returns the current value of a parm in source
+    PendingConfig(const void* source, FindFn find)
+        : mSource(source), mFind(find), mUpdates(nullptr), mCount(0)
+    {
+    }
+
+    /// Return a value as a 64-bit int.  Throws as AbstractCV::asInt() does.
+    int64_t asInt(TConfigEnum parm) const {
+        const AbstractCV& val = current(parm);
+        const PreparedValue* pv = pending(parm);
+        if (pv == nullptr) {
+            return val.asInt();
+        }
+        switch (val.kind()) {
+        case CVKind::Bool: return pv->b;
+        case CVKind::Str: return strToInt<int64_t>(pv->s);
+        default: return pv->i;
+        }
+    }
+
+    /// Return a value as a bool
+    bool asBool(TConfigEnum parm) const {
+        const AbstractCV& val = current(parm);
+        const PreparedValue* pv = pending(parm);
+        if (pv == nullptr) {
+            return val.asBool();
+        }
+        switch (val.kind()) {
+        case CVKind::Bool: return pv->b;
+        case CVKind::Str: return strToBool(pv->s);
+        default: return pv->i != 0;
+        }
+    }
+
+    /// Return a value as a string.  See AbstractCV::asStrView().
+    std::string_view asStrView(TConfigEnum parm, CVStrBuf& scratch) const {
+        const AbstractCV& val = current(parm);
+        const PreparedValue* pv = pending(parm);
+        if (pv == nullptr) {
+            return val.asStrView(scratch);
+        }
+        switch (val.kind()) {
+        case CVKind::Bool: return pv->b ? "true" : "false";
+        case CVKind::Str: return pv->s;
+        default: {
+            auto res = std::to_chars(scratch.data(), scratch.data() + scratch.size(), pv->i);
+            return std::string_view(scratch.data(), res.ptr - scratch.data());
+        }
+        }
+    }
+
+private:
+    static const AbstractCV* findParm(const void* parms, TConfigEnum parm) {
+        const Parms& p = *static_cast<const Parms*>(parms);
+        return p.inRange(parm) ? p[parm].get() : nullptr;
+    }
+
+    /// Return the current value of a parm or throw if it is not registered
+    const AbstractCV& current(TConfigEnum parm) const {
+        const AbstractCV* val = mFind(mSource, parm);
+        if (val == nullptr) {
+            throw std::out_of_range("Unknown config parm: " + std::to_string(enumIndex(parm)));
+        }
+        return *val;
+    }
+
+    /// Return the last pending update of a parm, or nullptr
+    const PreparedValue* pending(TConfigEnum parm) const {
+        for (std::size_t i = mCount; i > 0; --i) {
+            if (mUpdates[i - 1].first == parm) {
+                return mUpdates[i - 1].second;
+            }
+        }
+        return nullptr;
+    }
+
+    const void* mSource;
+    FindFn mFind;
+    const Update* mUpdates;
+    std::size_t mCount;
+};
+
+/// Constraint between the values of several config parms
+template <typename TConfigEnum>
+struct ConfigConstraint {
+    /// Description used in errors, e.g. "STRIDE_SIZE must divide MAX_ROWS_PER_ROWGROUP"
+    std::string_view what;
+    /// Return true if the values satisfy the constraint
+    bool (*check)(const PendingConfig<TConfigEnum>&);
+};
+
+/**
+   Constraints between the parms of a config enum.
+
+   Specialize with a static constexpr list[] of ConfigConstraint entries:
+
+       template <> struct ConfigConstraints<DatabaseConfigParm> {
+           static constexpr ConfigConstraint<DatabaseConfigParm> list[] = {
+               { "STRIDE_SIZE must divide MAX_ROWS_PER_ROWGROUP",
+                 [](const PendingConfig<DatabaseConfigParm>& cfg) {
+                     return cfg.asInt(DatabaseConfigParm::MAX_ROWS_PER_ROWGROUP)
+                            % cfg.asInt(DatabaseConfigParm::STRIDESIZE) == 0; } } };
+       };
+
+   ConfigTemplate checks them all when it is constructed, and against the
+   would-be values in set(), trySet() and setMany() before anything is
+   applied.  A constraint that throws counts as failed.  Checks on a single
+   parm run first, so a constraint can rely on them (e.g. a divisor already
+   checked to be at least 1).  Enums without a specialization have no
+   constraints and skip the check at compile time.
+
+   LayeredConfig, ScopedConfig and ConfigOverlay check the values they
+   resolve to when they are built and before each override or set() is
+   applied, through ConfigTemplate::checkConstraints().  They can't see
+   set() calls made on their base config, which are only checked against
+   the base's own values.
+*/
+template <typename TConfigEnum>
+struct ConfigConstraints {
+    static constexpr std::array<ConfigConstraint<TConfigEnum>, 0> list{};
+};
+
+/// Runs a task asynchronously.  Used to dispatch change notifications.
+using ConfigExecutor = std::function<void(std::function<void()>)>;
+
+/**
+   Executor that runs tasks in order on one worker thread.
+
+   The destructor runs any tasks still queued and then joins the thread.
+*/
+class SerialExecutor {
+    std::mutex mMutex;
+    std::condition_variable mCond;
+    std::deque<std::function<void()>> mTasks;
+    bool mStopping = false;
+    std::thread mThread;
+
+public:
+    SerialExecutor()
+        : mThread([this] { run(); })
+    {
+    }
+
+    SerialExecutor(const SerialExecutor&) = delete;
+    SerialExecutor& operator=(const SerialExecutor&) = delete;
+
+    ~SerialExecutor()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            mStopping = true;
+        }
+        mCond.notify_one();
+        mThread.join();
+    }
+
+    /// Queue a task to run on the worker thread
+    void post(std::function<void()> task)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            mTasks.push_back(std::move(task));
+        }
+        mCond.notify_one();
+    }
+
+private:
+    void run()
+    {
+        std::unique_lock<std::mutex> lock(mMutex);
+        while (true) {
+            mCond.wait(lock, [this] { return mStopping || !mTasks.empty(); });
+            if (mTasks.empty()) {
+                return;
+            }
+            auto task = std::move(mTasks.front());
+            mTasks.pop_front();
+            lock.unlock();
+            task();
+            lock.lock();
+        }
+    }
+};
+
+/**
+   Change subscriptions for the parms of one config.
+
+   notify() only marks the parm as changed and, if no dispatch is pending,
+   posts one to the executor.  The dispatch runs every subscriber whose parms
+   changed, once per batch no matter how many set() calls landed in it, so the
+   thread calling set() never runs or waits on subscribers.
+*/
+template <typename TConfigEnum>
+class ConfigNotifier {
+public:
+    /// Called with the subscribed parms that changed in a batch
+    using Callback = std::function<void(const std::vector<TConfigEnum>& changed)>;
+
+    /// Constructor.  Dispatches run on a worker thread of the notifier's own
+    /// until setExecutor() replaces it.
+    ConfigNotifier()
+        : mDefaultExecutor(new SerialExecutor)
+    {
+        mExecutor = [exec = mDefaultExecutor.get()](std::function<void()> task) { exec->post(std::move(task)); };
+    }
+
+    ConfigNotifier(const ConfigNotifier&) = delete;
+    ConfigNotifier& operator=(const ConfigNotifier&) = delete;
+
+    /// Destructor.  A custom executor must have run every posted dispatch
+    /// before the notifier goes away.
+    ~ConfigNotifier()
+    {
+        mDefaultExecutor.reset();
+    }
+
+    /// Register a callback for a group of parms
+    /// @return Id to pass to unsubscribe()
+    uint64_t subscribe(const std::vector<TConfigEnum>& parms, Callback cb)
+    {
+        Subscription sub{ ++mNextId, {}, std::move(cb) };
+        for (TConfigEnum parm : parms) {
+            sub.mask.set(enumIndex(parm));
+        }
+        std::lock_guard<std::mutex> lock(mMutex);
+        mSubs.push_back(std::move(sub));
+        return mSubs.back().id;
+    }
+
+    /// Remove a callback.  It may still run for a batch already dispatched.
+    void unsubscribe(uint64_t id)
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mSubs.erase(std::remove_if(mSubs.begin(), mSubs.end(), [id](const Subscription& s) { return s.id == id; }),
+                    mSubs.end());
+    }
+
+    /// Use a different executor for dispatches posted from now on
+    /// Throws std::invalid_argument if the executor is empty.
+    void setExecutor(ConfigExecutor executor)
+    {
+        if (!executor) {
+            throw std::invalid_argument("Config executor must not be empty");
+        }
+        std::lock_guard<std::mutex> lock(mMutex);
+        mExecutor = std::move(executor);
+    }
+
+    /// Record that a parm changed and make sure a dispatch is scheduled
+    void notify(TConfigEnum parm)
+    {
+        std::size_t idx = enumIndex(parm);
+        mPending[idx / 64].fetch_or(uint64_t(1) << (idx % 64));
+        if (!mScheduled.exchange(true)) {
+            ConfigExecutor exec;
+            {
+                std::lock_guard<std::mutex> lock(mMutex);
+                exec = mExecutor;
+            }
+            exec([this] { dispatch(); });
+        }
+    }
+
+private:
+    static constexpr std::size_t kCount = ConfigEnumCount<TConfigEnum>::value;
+
+    struct Subscription {
+        uint64_t id;
+        std::bitset<kCount> mask;
+        Callback cb;
+    };
+
+    /// Run the subscribers of every parm changed since the last dispatch
+    void dispatch()
+    {
+        mScheduled.store(false);
+        std::bitset<kCount> changed;
+        for (std::size_t w = 0; w < mPending.size(); ++w) {
+            uint64_t bits = mPending[w].exchange(0);
+            for (std::size_t b = 0; b < 64 && w * 64 + b < kCount; ++b) {
+                if (bits & (uint64_t(1) << b)) {
+                    changed.set(w * 64 + b);
+                }
+            }
+        }
+        if (changed.none()) {
+            return;
+        }
+
+        std::vector<Subscription> subs;
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            subs = mSubs;
+        }
+        std::vector<TConfigEnum> parms;
+        for (auto& sub : subs) {
+            auto hits = sub.mask & changed;
+            if (hits.none()) {
+                continue;
+            }
+            parms.clear();
+            for (std::size_t i = 0; i < kCount; ++i) {
+                if (hits[i]) {
+                    parms.push_back(static_cast<TConfigEnum>(i));
+                }
+            }
+            sub.cb(parms);
+        }
+    }
+
+    std::mutex mMutex;
+    std::vector<Subscription> mSubs;
+    std::atomic<uint64_t> mNextId{0};
+    /// Bit per parm that changed since the last dispatch
+    std::array<std::atomic<uint64_t>, (kCount + 63) / 64> mPending{};
+    /// True while a dispatch is posted but has not started
+    std::atomic<bool> mScheduled{false};
+    ConfigExecutor mExecutor;
+    /// Worker used when no executor was set.  Destroyed first so queued
+    /// dispatches finish while the rest of the notifier is still alive.
+    std::unique_ptr<SerialExecutor> mDefaultExecutor;
+};
+
+/// How a config value was read, for access instrumentation
+enum class StatRead : uint8_t {
+    /// as_<T>() with an integer or enum T
+    Int,
+    /// as_<bool>()
+    Bool,
+    /// as_<std::string>()
+    Str,
+    /// asStrView()
+    StrView,
+    /// get<Parm>()
+    Typed
+};
+
+constexpr std::size_t kStatReadKinds = 5;
+
+/// Classify an as_<T>() read by its target type.  Enums count as Int.
+template <typename T>
+constexpr StatRead statReadOf()
+{
+    if (std::is_same<T, bool>::value) {
+        return StatRead::Bool;
+    }
+    return (std::is_integral<T>::value || std::is_enum<T>::value) ? StatRead::Int : StatRead::Str;
+}
+
+#if CFG_TEMPLATE_STATS
+
+/// Latency histograms have power of two buckets: bucket b counts latencies
+/// below 2^b ns, the last one everything longer.
+constexpr std::size_t kStatHistBuckets = 40;
+
+/**
+   Aggregated access statistics of a config.  See ConfigTemplate::stats().
+*/
+struct ConfigStatsReport {
+    struct Parm {
+        std::string_view key;
+        /// Reads indexed by StatRead
+        std::array<uint64_t, kStatReadKinds> reads{};
+        uint64_t sets = 0;
+        uint64_t setFailures = 0;
+    };
+
+    /// One entry per registered parm, in enum order
+    std::vector<Parm> parms;
+    /// Time from entering a set to the value being published
+    std::array<uint64_t, kStatHistBuckets> setLatency{};
+    /// Time from a value being published to its first read
+    std::array<uint64_t, kStatHistBuckets> visibility{};
+
+    /// Render the report as text, one line per parm, then the histograms
+    std::string str() const {
+        static constexpr const char* kReadNames[kStatReadKinds] = { "int", "bool", "str", "strview", "typed" };
+        std::string out;
+        for (auto& p : parms) {
+            out.append(p.key);
+            for (std::size_t k = 0; k < kStatReadKinds; ++k) {
+                out.append(" ").append(kReadNames[k]).append("=").append(std::to_string(p.reads[k]));
+            }
+            out.append(" sets=").append(std::to_string(p.sets));
+            out.append(" failed=").append(std::to_string(p.setFailures)).append("\n");
+        }
+        appendHist(out, "set_latency_ns", setLatency);
+        appendHist(out, "visibility_ns", visibility);
+        return out;
+    }
+
+private:
+    static void appendHist(std::string& out, const char* name, const std::array<uint64_t, kStatHistBuckets>& hist) {
+        out.append(name).append(":");
+        for (std::size_t b = 0; b < kStatHistBuckets; ++b) {
+            if (hist[b] != 0) {
+                out.append(" <").append(std::to_string(uint64_t(1) << b)).append("=").append(std::to_string(hist[b]));
+            }
+        }
+        out.append("\n");
+    }
+};
+
+/// Number of stats shards that a thread can own outright
+constexpr unsigned kStatOwnedShards = 16;
+
+/**
+   Return the calling thread's stats shard number.
+
+   Each live thread gets a number below kStatOwnedShards to itself while one is
+   free, and gives it back when it exits; every other thread gets
+   kStatOwnedShards, the shared shard.  The number is the same for every
+   config, so a thread that owns one is the only writer of that shard
+   everywhere.
+*/
+inline unsigned statThreadShard()
+{
+    static std::atomic<uint64_t> taken{0};
+    struct Slot {
+        unsigned id = kStatOwnedShards;
+        Slot() {
+            uint64_t cur = taken.load(std::memory_order_relaxed);
+            for (unsigned i = 0; i < kStatOwnedShards;) {
+                uint64_t bit = uint64_t(1) << i;
+                if (cur & bit) {
+                    ++i;
+                } else if (taken.compare_exchange_weak(cur, cur | bit, std::memory_order_acq_rel)) {
+                    id = i;
+                    return;
+                }
+            }
+        }
+        ~Slot() {
+            if (id < kStatOwnedShards) {
+                taken.fetch_and(~(uint64_t(1) << id), std::memory_order_acq_rel);
+            }
+        }
+    };
+    thread_local Slot slot;
+    return slot.id;
+}
+
+/**
+   Access counters for the parms of a config.
+
+   Counters are spread over shards, each on its own cache lines.  A thread
+   that owns a shard (see statThreadShard()) bumps its counters with a plain
+   load and store, so counting costs no more than an uncontended memory
+   write; threads without one share the last shard and use atomic adds.
+   Shards are only summed when a report is taken.  Value-initialize it (new
+   ConfigStats()) so the counters start at zero.
+*/
+template <typename TConfigEnum>
+class ConfigStats {
+public:
+    static constexpr std::size_t kShards = kStatOwnedShards + 1;
+
+    /// Count a read, and record its visibility latency if it is the first
+    /// read since the value was set
+    void countRead(std::size_t idx, StatRead kind) noexcept {
+        unsigned id = statThreadShard();
+        Shard& sh = mShards[id];
+        bump(sh.reads[idx][static_cast<std::size_t>(kind)], id);
+        if (mPublished[idx].load(std::memory_order_relaxed) != 0) {
+            int64_t published = mPublished[idx].exchange(0, std::memory_order_relaxed);
+            if (published != 0) {
+                bump(sh.visibility[bucket(now() - published)], id);
+            }
+        }
+    }
+
+    /// Count a set and, if it was applied, record its latency
+    /// @param[in] started now() when the set began
+    void countSet(std::size_t idx, bool applied, int64_t started) noexcept {
+        unsigned id = statThreadShard();
+        Shard& sh = mShards[id];
+        if (!applied) {
+            bump(sh.setFailures[idx], id);
+            return;
+        }
+        int64_t t = now();
+        bump(sh.sets[idx], id);
+        bump(sh.setLatency[bucket(t - started)], id);
+        mPublished[idx].store(t, std::memory_order_relaxed);
+    }
+
+    /// Sum the shards into a report
+    /// @param[in] keyOf Returns the key of a slot, or an empty view if the
+    ///            slot is not registered
+    template <typename KeyFn>
+    ConfigStatsReport report(KeyFn keyOf) const {
+        ConfigStatsReport rep;
+        for (std::size_t i = 0; i < kCount; ++i) {
+            std::string_view key = keyOf(i);
+            if (key.empty()) {
+                continue;
+            }
+            ConfigStatsReport::Parm p;
+            p.key = key;
+            for (auto& sh : mShards) {
+                for (std::size_t k = 0; k < kStatReadKinds; ++k) {
+                    p.reads[k] += sh.reads[i][k].load(std::memory_order_relaxed);
+                }
+                p.sets += sh.sets[i].load(std::memory_order_relaxed);
+                p.setFailures += sh.setFailures[i].load(std::memory_order_relaxed);
+            }
+            rep.parms.push_back(p);
+        }
+        for (auto& sh : mShards) {
+            for (std::size_t b = 0; b < kStatHistBuckets; ++b) {
+                rep.setLatency[b] += sh.setLatency[b].load(std::memory_order_relaxed);
+                rep.visibility[b] += sh.visibility[b].load(std::memory_order_relaxed);
+            }
+        }
+        return rep;
+    }
+
+    /// Monotonic clock in ns, as passed to countSet()
+    static int64_t now() noexcept {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+private:
+    static constexpr std::size_t kCount = ConfigEnumCount<TConfigEnum>::value;
+
+    using Counter = std::atomic<uint64_t>;
+    using Histogram = std::array<Counter, kStatHistBuckets>;
+
+    struct alignas(kCacheLineSize) Shard {
+        std::array<std::array<Counter, kStatReadKinds>, kCount> reads;
+        std::array<Counter, kCount> sets;
+        std::array<Counter, kCount> setFailures;
+        Histogram setLatency;
+        Histogram visibility;
+    };
+
+    /// Add one to a counter in shard id
+    static void bump(Counter& c, unsigned id) noexcept {
+        if (id < kStatOwnedShards) {
+            c.store(c.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        } else {
+            c.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+
+    /// Histogram bucket for a latency
+    static std::size_t bucket(int64_t ns) noexcept {
+        std::size_t b = 0;
+        while (b + 1 < kStatHistBuckets && ns >= (int64_t(1) << b)) {
+            ++b;
+        }
+        return b;
+    }
+
+    std::array<Shard, kShards> mShards;
+    /// now() when each value was last set, or 0 once it has been read since
+    std::array<std::atomic<int64_t>, kCount> mPublished;
+};
+
+#endif // CFG_TEMPLATE_STATS
+
+/**
+   The template class to hold a set of config parameters.
+
+   Each config parameter has an associated config value that you use to get/set
+   its value.
+*/
+template <typename TConfigEnum>
+class ConfigTemplate
+{
+    /// Memory resource the config values are allocated from
+    std::pmr::memory_resource* mResource;
+    /// Config values indexed by config parm
+    EnumIndexedArray<TConfigEnum, std::shared_ptr<AbstractCV>> mParms;
+
+public:
+    /// Constructor
+    /// The overrides are only read during construction and are not kept.
+    ///
+    /// @param[in] overrides List of key/value pairs for specific config parms
+    ///            that are being overridden.  For each pair, it will override
+    ///            the hard-coded default.  Either a std::map or a view such
+    ///            as ConfigSource::overrides(), which avoids building a map.
+    /// @param[in] resource Memory resource to allocate the config values from.
+    ///            Pass an arena (see ConfigArena) to keep a whole config in
+    ///            one contiguous block, and build the overrides with it too.
+    ConfigTemplate(const ConfigOverrides& overrides,
+                   std::pmr::memory_resource* resource = std::pmr::get_default_resource())
+        : ConfigTemplate(CVFactory(overrides, resource))
+    {
+    }
+
+    /// Constructor
+    /// Each instantiation of the template will use template specialization to
+    /// seed mResource from factory.resource() and the mParms array from the
+    /// factory.  Enums with a ConfigRegistry use the generic definition.
+    /// @param[in] factory Factory to make the config values with
+    explicit ConfigTemplate(CVFactory&& factory);
+
+    /// Move constructor
+    /// The config values, key index and subscriptions are handed over without
+    /// copying.  Move a config before sharing it between threads, e.g. to build
+    /// it on a background thread and hand it to a worker.  The moved-from
+    /// config knows no parms: find() returns nullptr, as_(), asStrView() and
+    /// set() throw std::out_of_range, and get<>() must not be called.
+    ConfigTemplate(ConfigTemplate&& other) noexcept
+        : mResource(other.mResource)
+        , mParms(std::move(other.mParms))
+        , mKeyIndex(std::move(other.mKeyIndex))
+        , mHot(std::move(other.mHot))
+        , mNotifier(other.mNotifier.exchange(nullptr))
+#if CFG_TEMPLATE_STATS
+        , mStats(other.mStats.exchange(nullptr))
+#endif
+        , mVersion(other.mVersion.load())
+    {
+        other.mParms = {};
+    }
+
+    ConfigTemplate(const ConfigTemplate&) = delete;
+    ConfigTemplate& operator=(const ConfigTemplate&) = delete;
+    ConfigTemplate& operator=(ConfigTemplate&&) = delete;
+
+    ~ConfigTemplate()
+    {
+        delete mNotifier.load();
+#if CFG_TEMPLATE_STATS
+        delete mStats.load();
+#endif
+    }
+
+    /// Get a config value as a specific type
+    /// Throws std::out_of_range if the parm was never registered.
+    /// @tparam T The type to get the value as.
+    /// @param[in] parm Config parm to lookup
+    template <typename T>
+    T as_(TConfigEnum parm) const {
+        T returnVal;
+        convertToType(lookup(parm), returnVal);
+        countRead(parm, statReadOf<T>());
+        return returnVal;
+    }
+
+    /// Get a config value in its storage type.
+    ///
+    /// The storage type comes from ConfigParmTraits, so the read is a direct
+    /// non-virtual load from the config value with no conversion.
+    /// @tparam Parm Config parm to lookup.  Must be registered in this config.
+    template <TConfigEnum Parm>
+    typename ConfigParmTraits<TConfigEnum, Parm>::CVType::value_type get() const {
+        using CVType = typename ConfigParmTraits<TConfigEnum, Parm>::CVType;
+        static_assert(decltype(mParms)::inRange(Parm), "Config parm is out of range");
+        const AbstractCV* val = mParms[Parm].get();
+        assert(dynamic_cast<const CVType*>(val) != nullptr);
+        countRead(Parm, StatRead::Typed);
+        return static_cast<const CVType*>(val)->value();
+    }
+
+    /// Get a config value as a string without allocating.
+    /// Throws std::out_of_range if the parm was never registered.
+    /// @param[in] parm Config parm to lookup
+    /// @param[in] scratch Buffer for values that have to be rendered on read.
+    ///            The returned view may point into it.
+    std::string_view asStrView(TConfigEnum parm, CVStrBuf& scratch) const {
+        std::string_view view = lookup(parm).asStrView(scratch);
+        countRead(parm, StatRead::StrView);
+        return view;
+    }
+
+    /// Get a config value as a specific type without throwing for unknown parms.
+    ///
+    /// The read path never modifies the config, so it is safe to call from any
+    /// number of threads concurrently without locking.
+    /// @tparam T The type to get the value as.
+    /// @param[in] parm Config parm to lookup
+    /// @param[out] returnVal Set to the value if the parm is known
+    /// @return false if the parm is not registered in this config
+    template <typename T>
+    bool tryAs_(TConfigEnum parm, T& returnVal) const {
+        const AbstractCV* val = find(parm);
+        if (val == nullptr) {
+            return false;
+        }
+        convertToType(*val, returnVal);
+        countRead(parm, statReadOf<T>());
+        return true;
+    }
+
+    /// Find the config value for a parm
+    /// @param[in] parm Config parm to lookup
+    /// @return The config value, or nullptr if the parm is out of range
+    const AbstractCV* find(TConfigEnum parm) const noexcept {
+        if (!mParms.inRange(parm)) {
+            return nullptr;
+        }
+        return mParms[parm].get();
+    }
+
+    /// Return true if the parm is registered in this config
+    bool contains(TConfigEnum parm) const noexcept { return find(parm) != nullptr; }
+
+    /// Find the config parm registered under a key
+    /// @param[in] key String name of the config value, as passed to CVFactory
+    /// @param[out] parm Set to the config parm if the key is known
+    /// @return false if no config value has that key
+    bool parmForKey(std::string_view key, TConfigEnum& parm) const noexcept {
+        uint32_t idx = mKeyIndex.find(key);
+        if (idx == KeyHashIndex::npos) {
+            return false;
+        }
+        parm = static_cast<TConfigEnum>(idx);
+        return true;
+    }
+
+    /// Find the config value registered under a key
+    /// @param[in] key String name of the config value
+    /// @return The config value or nullptr if no config value has that key
+    const AbstractCV* findByKey(std::string_view key) const noexcept {
+        TConfigEnum parm;
+        return parmForKey(key, parm) ? find(parm) : nullptr;
+    }
+
+    /// Get a config value as a specific type using its string key
+    /// Throws std::out_of_range if no config value has that key.
+    /// @tparam T The type to get the value as.
+    /// @param[in] key String name of the config value
+    template <typename T>
+    T as_(std::string_view key) const {
+        return as_<T>(parmForKey(key));
+    }
+
+    /// Set a config value using its string key
+    /// Throws std::out_of_range if no config value has that key, or the same
+    /// exceptions as set(TConfigEnum, ...).
+    /// @param[in] key String name of the config value
+    /// @param[in] newVal New value to set.
+    void set(std::string_view key, const std::string& newVal) {
+        set(parmForKey(key), newVal);
+    }
+
+    /// Set a config value
+    /// This will throw an exception if this used with a read-only config value,
+    /// if the parm was never registered, or if the value fails its checks or
+    /// a ConfigConstraints entry (std::invalid_argument).
+    /// @param[in] parm Config parm to set
+    /// @param[in] newVal New value to set.
+    void set(TConfigEnum parm, const std::string& newVal) {
+        AbstractCV& val = lookup(parm);
+        const ConfigConstraint<TConfigEnum>* failed = nullptr;
+        SetError err = setOne(parm, val, newVal, failed);
+        if (failed != nullptr) {
+            throw std::invalid_argument("Config constraint failed: " + std::string(failed->what));
+        } else if (err != SetError::None) {
+            val.throwSetError(err, newVal);
+        }
+    }
+
+    /// Set a config value without throwing
+    /// @param[in] parm Config parm to set
+    /// @param[in] newVal New value to set.
+    /// @return SetError::None if the value was applied
+    SetError trySet(TConfigEnum parm, std::string_view newVal) {
+        AbstractCV* val = mParms.inRange(parm) ? mParms[parm].get() : nullptr;
+        if (val == nullptr) {
+            return SetError::UnknownParm;
+        }
+        const ConfigConstraint<TConfigEnum>* failed = nullptr;
+        return setOne(parm, *val, newVal, failed);
+    }
+
+    /// Set several config values as one update.
+    ///
+    /// Every value is parsed and validated before any is applied.  If any
+    /// update fails, nothing is applied.  Otherwise all of them are applied
+    /// under one version change, so version-checked readers (e.g.
+    /// CachedConfigView) see either none or all of them.
+    /// @param[in] updates Pairs of config parm and its new value
+    /// @return Result for each update, in the same order.  All SetError::None
+    ///         if the batch was applied.  Otherwise the updates that were
+    ///         valid on their own report SetError::BatchRejected.
+    std::vector<SetError> setMany(const std::vector<std::pair<TConfigEnum, std::string>>& updates) {
+        return setMany(updates, [](TConfigEnum, const PendingConfig<TConfigEnum>&) { return SetError::None; });
+    }
+
+    /// Set several config values as one update, with an extra check on each.
+    /// See setMany().  Once every update has been prepared, check(parm,
+    /// pending) runs for each of them under the write lock and returns
+    /// SetError::None to accept it.  Any other result rejects the batch, as a
+    /// value that failed to parse would.
+    template <typename Check>
+    std::vector<SetError> setMany(const std::vector<std::pair<TConfigEnum, std::string>>& updates, Check&& check) {
+        int64_t started = setStarted();
+        std::vector<SetError> results(updates.size(), SetError::None);
+        std::vector<AbstractCV*> vals(updates.size(), nullptr);
+        std::vector<PreparedValue> prepared(updates.size());
+        std::vector<typename PendingConfig<TConfigEnum>::Update> pending;
+        pending.reserve(updates.size());
+        bool ok = true;
+        {
+            // prepare() may allocate from mResource, which need not be
+            // thread-safe, so it runs under the lock along with the commit
+            std::lock_guard<std::mutex> lock(mWriteMutex);
+            for (std::size_t i = 0; i < updates.size(); ++i) {
+                vals[i] = mParms.inRange(updates[i].first) ? mParms[updates[i].first].get() : nullptr;
+                if (vals[i] == nullptr) {
+                    results[i] = SetError::UnknownParm;
+                } else {
+                    prepared[i].s = updates[i].second;
+                    results[i] = vals[i]->prepare(updates[i].second, prepared[i]);
+                    pending.emplace_back(updates[i].first, &prepared[i]);
+                }
+                ok = ok && results[i] == SetError::None;
+            }
+            if (ok) {
+                const PendingConfig<TConfigEnum> next(mParms, pending.data(), pending.size());
+                for (std::size_t i = 0; i < updates.size(); ++i) {
+                    results[i] = check(updates[i].first, next);
+                    ok = ok && results[i] == SetError::None;
+                }
+            }
+
+            if (ok && failedConstraint(mParms, pending.data(), pending.size()) != nullptr) {
+                // The combination is at fault, so every update shares the blame
+                std::fill(results.begin(), results.end(), SetError::Constraint);
+                ok = false;
+            } else if (ok) {
+                mVersion.fetch_add(1, std::memory_order_acq_rel);
+                for (std::size_t i = 0; i < updates.size(); ++i) {
+                    vals[i]->commit(prepared[i]);
+                }
+                mVersion.fetch_add(1, std::memory_order_release);
+            }
+            // Unused buffers go back to mResource under the lock as well
+            prepared.clear();
+        }
+        if (!ok) {
+            for (std::size_t i = 0; i < updates.size(); ++i) {
+                if (results[i] == SetError::None) {
+                    results[i] = SetError::BatchRejected;
+                }
+                if (vals[i] != nullptr) {
+                    countSet(updates[i].first, false, started);
+                }
+            }
+            return results;
+        }
+        for (auto& u : updates) {
+            countSet(u.first, true, started);
+            notifyChanged(u.first);
+        }
+        return results;
+    }
+
+    /// Set several config values as one update, using their string keys.
+    /// See setMany(const std::vector<std::pair<TConfigEnum, std::string>>&).
+    std::vector<SetError> setMany(const std::vector<std::pair<std::string, std::string>>& updates) {
+        std::vector<std::pair<TConfigEnum, std::string>> byParm;
+        byParm.reserve(updates.size());
+        for (std::size_t i = 0; i < updates.size(); ++i) {
+            TConfigEnum parm;
+            if (!parmForKey(updates[i].first, parm)) {
+                // Out of range, so the batch reports it as an unknown parm
+                parm = static_cast<TConfigEnum>(ConfigEnumCount<TConfigEnum>::value);
+            }
+            byParm.emplace_back(parm, updates[i].second);
+        }
+        return setMany(byParm);
+    }
+
+    /// Callback run after subscribed parms change
+    using ChangeCallback = typename ConfigNotifier<TConfigEnum>::Callback;
+
+    /// Subscribe to changes of one parm
+    /// The callback runs asynchronously on the notification executor after a
+    /// successful set().  Changes that land close together are batched.
+    /// @return Id to pass to unsubscribe()
+    uint64_t subscribe(TConfigEnum parm, ChangeCallback cb) {
+        return notifier().subscribe({ parm }, std::move(cb));
+    }
+
+    /// Subscribe to changes of any parm in a group
+    /// The callback gets the parms of the group that changed in the batch.
+    /// @return Id to pass to unsubscribe()
+    uint64_t subscribe(const std::vector<TConfigEnum>& parms, ChangeCallback cb) {
+        return notifier().subscribe(parms, std::move(cb));
+    }
+
+    /// Remove a subscription
+    void unsubscribe(uint64_t id) { notifier().unsubscribe(id); }
+
+    /// Run change notifications on an executor instead of the default worker
+    /// thread.  The executor must run every posted task before the config is
+    /// destroyed.  Throws std::invalid_argument if the executor is empty.
+    void setExecutor(ConfigExecutor executor) { notifier().setExecutor(std::move(executor)); }
+
+    /// Return the memory resource the config values are allocated from
+    std::pmr::memory_resource* resource() const { return mResource; }
+
+#if CFG_TEMPLATE_STATS
+    /// Start counting reads and sets of this config.
+    ///
+    /// Counts as_<T>() reads by target type, as well as asStrView() and
+    /// get<>() reads, and set() calls and failures, along with the latency of
+    /// each set and the time until a new value is first read.  Reads made
+    /// through find() or a CachedConfigView are not counted.
+    void enableStats() {
+        if (mStats.load(std::memory_order_acquire) == nullptr) {
+            std::unique_ptr<ConfigStats<TConfigEnum>> created(new ConfigStats<TConfigEnum>());
+            ConfigStats<TConfigEnum>* expected = nullptr;
+            if (mStats.compare_exchange_strong(expected, created.get(), std::memory_order_acq_rel)) {
+                created.release();
+            }
+        }
+    }
+
+    /// Return the counters gathered since enableStats(), or an empty report
+    ConfigStatsReport stats() const {
+        ConfigStats<TConfigEnum>* stats = mStats.load(std::memory_order_acquire);
+        if (stats == nullptr) {
+            return {};
+        }
+        return stats->report([this](std::size_t i) {
+            const AbstractCV* val = find(static_cast<TConfigEnum>(i));
+            return val != nullptr ? val->key() : std::string_view();
+        });
+    }
+#endif
+
+    /// Return the config version.  It changes with every set() and setMany(),
+    /// so readers can cache values and only reload them when it moves.  It is
+    /// odd while an update is being applied.
+    uint64_t version() const { return mVersion.load(std::memory_order_acquire); }
+
+    /// Run reads of several values until they complete within one even
+    /// version, so they see all of an update or none of it.  reads may run
+    /// more than once and must be safe to repeat.
+    /// @return The version the reads completed in
+    template <typename Fn>
+    uint64_t readConsistent(Fn&& reads) const {
+        uint64_t v;
+        do {
+            while ((v = version()) & 1) {
+            }
+            reads();
+        } while (version() != v);
+        return v;
+    }
+
+    /// True if the enum has any ConfigConstraints to check
+    static constexpr bool kHasConstraints = std::size(ConfigConstraints<TConfigEnum>::list) != 0;
+
+    /// Check the config constraints against a layer of overrides on a config,
+    /// such as a LayeredConfig, as it would be with one value replaced.
+    /// Throws std::invalid_argument naming the first constraint broken.
+    /// @param[in] layer Values to check.  Anything with a find(parm) that
+    ///            returns a const AbstractCV*, or nullptr for unknown parms.
+    /// @param[in] parm Parm to replace.  Out of range to replace none.
+    /// @param[in] val Value to check in place of the parm's current one
+    template <typename Layer>
+    static void checkConstraints(const Layer& layer,
+                                 TConfigEnum parm = static_cast<TConfigEnum>(ConfigEnumCount<TConfigEnum>::value),
+                                 const AbstractCV* val = nullptr) {
+        if constexpr (kHasConstraints) {
+            struct Candidate {
+                const Layer& layer;
+                TConfigEnum parm;
+                const AbstractCV* val;
+
+                static const AbstractCV* find(const void* self, TConfigEnum p) {
+                    auto& c = *static_cast<const Candidate*>(self);
+                    return p == c.parm ? c.val : c.layer.find(p);
+                }
+            };
+            Candidate candidate{ layer, parm, val };
+            if (const ConfigConstraint<TConfigEnum>* failed =
+                    failedConstraint(PendingConfig<TConfigEnum>(&candidate, &Candidate::find))) {
+                throw std::invalid_argument("Config constraint failed: " + std::string(failed->what));
+            }
+        }
+    }
+
+private:
+    // Instrumentation hooks.  They compile to nothing unless CFG_TEMPLATE_STATS
+    // is set, and cost one load while stats are not enabled.
+#if CFG_TEMPLATE_STATS
+    void countRead(TConfigEnum parm, StatRead kind) const {
+        if (ConfigStats<TConfigEnum>* stats = mStats.load(std::memory_order_acquire)) {
+            stats->countRead(enumIndex(parm), kind);
+        }
+    }
+
+    int64_t setStarted() const {
+        return mStats.load(std::memory_order_acquire) != nullptr ? ConfigStats<TConfigEnum>::now() : 0;
+    }
+
+    void countSet(TConfigEnum parm, bool applied, int64_t started) const {
+        ConfigStats<TConfigEnum>* stats = mStats.load(std::memory_order_acquire);
+        if (stats != nullptr && mParms.inRange(parm)) {
+            stats->countSet(enumIndex(parm), applied, started);
+        }
+    }
+#else
+    void countRead(TConfigEnum, StatRead) const {}
+    int64_t setStarted() const { return 0; }
+    void countSet(TConfigEnum, bool, int64_t) const {}
+#endif
+
+    /// Prepare, check and apply one update.  Shared by set() and trySet().
+    /// @param[out] failed The constraint that rejected the update, if any
+    /// prepare() runs under mWriteMutex too, since it may allocate from
+    /// mResource, which need not be thread-safe (e.g. a ConfigArena).
+    SetError setOne(TConfigEnum parm, AbstractCV& val, std::string_view newVal,
+                    const ConfigConstraint<TConfigEnum>*& failed) {
+        int64_t started = setStarted();
+        SetError err;
+        {
+            std::lock_guard<std::mutex> lock(mWriteMutex);
+            PreparedValue prepared;
+            prepared.s = newVal;
+            err = val.prepare(newVal, prepared);
+            if (err == SetError::None) {
+                typename PendingConfig<TConfigEnum>::Update pending{ parm, &prepared };
+                failed = failedConstraint(mParms, &pending, 1);
+                if (failed != nullptr) {
+                    err = SetError::Constraint;
+                } else {
+                    mVersion.fetch_add(1, std::memory_order_acq_rel);
+                    val.commit(prepared);
+                    mVersion.fetch_add(1, std::memory_order_release);
+                }
+            }
+        }
+        countSet(parm, err == SetError::None, started);
+        if (err == SetError::None) {
+            notifyChanged(parm);
+        }
+        return err;
+    }
+
+    /// Return the first config constraint that values with updates applied
+    /// would break, or nullptr.  Set callers hold mWriteMutex so the values
+    /// can't move under the check.
+    static const ConfigConstraint<TConfigEnum>* failedConstraint(
+        const EnumIndexedArray<TConfigEnum, std::shared_ptr<AbstractCV>>& parms,
+        const typename PendingConfig<TConfigEnum>::Update* updates, std::size_t count) {
+        return failedConstraint(PendingConfig<TConfigEnum>(parms, updates, count));
+    }
+
+    /// Return the first config constraint that values break, or nullptr
+    static const ConfigConstraint<TConfigEnum>* failedConstraint(const PendingConfig<TConfigEnum>& pending) {
+        if constexpr (!kHasConstraints) {
+            return nullptr;
+        } else {
+            for (const auto& constraint : ConfigConstraints<TConfigEnum>::list) {
+                bool ok;
+                try {
+                    ok = constraint.check(pending);
+                } catch (const std::exception&) {
+                    ok = false;
+                }
+                if (!ok) {
+                    return &constraint;
+                }
+            }
+            return nullptr;
+        }
+    }
+
+    /// Tell subscribers, if any, that a parm changed
+    void notifyChanged(TConfigEnum parm) {
+        if (ConfigNotifier<TConfigEnum>* notifier = mNotifier.load(std::memory_order_acquire)) {
+            notifier->notify(parm);
+        }
+    }
+
+    /// Return the notifier, creating it on first use
+    ConfigNotifier<TConfigEnum>& notifier() {
+        ConfigNotifier<TConfigEnum>* cur = mNotifier.load(std::memory_order_acquire);
+        if (cur == nullptr) {
+            std::unique_ptr<ConfigNotifier<TConfigEnum>> created(new ConfigNotifier<TConfigEnum>);
+            if (mNotifier.compare_exchange_strong(cur, created.get(), std::memory_order_acq_rel)) {
+                cur = created.release();
+            }
+        }
+        return *cur;
+    }
+
+    /// Return the config parm for a key or throw if it is not registered
+    TConfigEnum parmForKey(std::string_view key) const {
+        TConfigEnum parm;
+        if (!parmForKey(key, parm)) {
+            throw std::out_of_range("Unknown config key: " + std::string(key));
+        }
+        return parm;
+    }
+
+    /// Build the config values declared in the ConfigRegistry for the enum
+    static EnumIndexedArray<TConfigEnum, std::shared_ptr<AbstractCV>> makeRegistryParms(CVFactory& factory) {
+        static_assert(registryComplete<TConfigEnum>(), "Every config parm must be in the registry exactly once");
+        static_assert(registryKeysUnique<TConfigEnum>(), "Config registry keys must be non-empty and unique");
+        static_assert(registryDefaultsFit<TConfigEnum>(), "Config registry default does not fit its integer type");
+        static_assert(registryDefaultsPassChecks<TConfigEnum>(), "Config registry default fails its parm's checks");
+        EnumIndexedArray<TConfigEnum, std::shared_ptr<AbstractCV>> parms{};
+        for (const auto& def : ConfigRegistry<TConfigEnum>::parms) {
+            parms.at(def.parm) = factory.Make(def);
+        }
+        return parms;
+    }
+
+    /// Build the key index for a set of config values
+    /// Every constructor goes through here, so this is also where a
+    /// specialized constructor that leaves a parm out is caught, with
+    /// std::logic_error (registry tables are checked at compile time
+    /// instead), and where the initial values are checked against
+    /// ConfigConstraints, with std::invalid_argument.
+    static KeyHashIndex indexKeys(const EnumIndexedArray<TConfigEnum, std::shared_ptr<AbstractCV>>& parms,
+                                  std::pmr::memory_resource* resource) {
+        std::pmr::vector<std::pair<std::string_view, uint32_t>> entries(resource);
+        entries.reserve(parms.size);
+        for (std::size_t i = 0; i < parms.size; ++i) {
+            auto& val = parms[static_cast<TConfigEnum>(i)];
+            if (!val) {
+                throw std::logic_error("Config parm is not registered: " + std::to_string(i));
+            }
+            entries.emplace_back(val->key(), static_cast<uint32_t>(i));
+        }
+        if (const ConfigConstraint<TConfigEnum>* failed = failedConstraint(parms, nullptr, 0)) {
+            throw std::invalid_argument("Config constraint failed: " + std::string(failed->what));
+        }
+        return KeyHashIndex(std::move(entries), resource);
+    }
+
+    /// Return the config value for a parm or throw if it is out of range.
+    /// Construction fills every in-range slot, but a moved-from config has
+    /// none, so the slot is still checked.
+    AbstractCV& lookup(TConfigEnum parm) const {
+        if (!mParms.inRange(parm) || !mParms[parm]) {
+            throw std::out_of_range("Unknown config parm: " + std::to_string(enumIndex(parm)));
+        }
+        return *mParms[parm];
+    }
+
+    /// Maps the key of each config value to its config parm
+    KeyHashIndex mKeyIndex{indexKeys(mParms, mResource)};
+    /// Padded storage for the updatable values, if enabled
+    HotValueBlock mHot{mParms, ConfigPadUpdatable<TConfigEnum>::value, mResource};
+
+    /// Serializes set() and setMany() so version changes bracket each update
+    std::mutex mWriteMutex;
+    /// Change subscriptions.  Only created once someone subscribes.
+    std::atomic<ConfigNotifier<TConfigEnum>*> mNotifier{nullptr};
+#if CFG_TEMPLATE_STATS
+    /// Access counters.  Only created by enableStats().
+    std::atomic<ConfigStats<TConfigEnum>*> mStats{nullptr};
+#endif
+
+    /// Bumped after each set().  Kept on its own cache line since every cached
+    /// reader polls it.
+    alignas(kCacheLineSize) std::atomic<uint64_t> mVersion{0};
+};
+
+/// Constructor for config enums declared through a ConfigRegistry.
+/// Enums without a registry provide a specialization of this constructor.
+template <typename TConfigEnum>
+ConfigTemplate<TConfigEnum>::ConfigTemplate(CVFactory&& factory)
+    : mResource(factory.resource())
+    , mParms(makeRegistryParms(factory))
+{
+}
+
+/**
+   Per-thread cached view of a ConfigTemplate.
+
+   Keeps local copies of the integer and bool form of every config value and
+   reloads them only when the config version changes.  A read is a local load
+   plus one compare against the shared version, so readers don't pull the
+   cache lines of updatable values across cores.
+
+   A view must only be used by a single thread, e.g. by declaring it
+   thread_local.  The config must outlive the view.
+*/
+template <typename TConfigEnum>
+class CachedConfigView
+{
+public:
+    using Config = ConfigTemplate<TConfigEnum>;
+
+    /// Constructor
+    /// @param[in] cfg Config to cache values from
+    explicit CachedConfigView(const Config& cfg)
+        : mCfg(cfg)
+    {
+        refresh();
+    }
+
+    /// Get a config value as a specific type
+    /// Integer, enum and bool reads come from the local copy.  Other types are
+    /// forwarded to the underlying config.
+    /// @tparam T The type to get the value as.
+    /// @param[in] parm Config parm to lookup
+    template <typename T>
+    T as_(TConfigEnum parm) const {
+        if constexpr (std::is_same<T, bool>::value || std::is_integral<T>::value || std::is_enum<T>::value) {
+            if (mCfg.version() != mVersion) {
+                refresh();
+            }
+            std::size_t idx = enumIndex(parm);
+            if (idx >= mInts.size() || !mCached[idx]) {
+                return mCfg.template as_<T>(parm);
+            }
+            if constexpr (std::is_same<T, bool>::value) {
+                return mBools[idx];
+            } else if constexpr (std::is_enum<T>::value) {
+                if (mTags[idx] != &cvEnumTag<T>) {
+                    // The config throws for a value of another type
+                    return mCfg.template as_<T>(parm);
+                }
+                return static_cast<T>(mInts[idx]);
+            } else {
+                return static_cast<T>(mInts[idx]);
+            }
+        } else {
+            return mCfg.template as_<T>(parm);
+        }
+    }
+
+    /// Reload the local copies from the config.  Retries until they were all
+    /// read within one even config version, so they never mix two updates.
+    void refresh() const {
+        mVersion = mCfg.readConsistent([this] {
+            for (std::size_t i = 0; i < mInts.size(); ++i) {
+                const AbstractCV* val = mCfg.find(static_cast<TConfigEnum>(i));
+                mCached[i] = val != nullptr && read(*val, mInts[i], mBools[i]);
+                mTags[i] = val != nullptr ? val->enumTag() : nullptr;
+            }
+        });
+    }
+
+private:
+    static constexpr std::size_t kCount = ConfigEnumCount<TConfigEnum>::value;
+
+    /// Read a value's integer and bool forms with one load of it, so a
+    /// concurrent set() of a string value can't make the read throw.
+    /// @return False if the value has no integer form
+    static bool read(const AbstractCV& val, int64_t& intVal, bool& boolVal) {
+        switch (val.kind()) {
+        case CVKind::Bool:
+            boolVal = val.asBool();
+            intVal = boolVal;
+            return true;
+        case CVKind::Str: {
+            CVStrBuf unused;
+            std::string_view text = val.asStrView(unused);
+            auto res = std::from_chars(text.data(), text.data() + text.size(), intVal);
+            boolVal = strToBool(text);
+            return !text.empty() && res.ec == std::errc() && res.ptr == text.data() + text.size();
+        }
+        default:
+            intVal = val.asInt();
+            boolVal = val.asBool();
+            return true;
+        }
+    }
+
+    const Config& mCfg;
+    /// Version of the config the local copies were taken at
+    mutable uint64_t mVersion = 0;
+    mutable std::array<int64_t, kCount> mInts{};
+    mutable std::array<bool, kCount> mBools{};
+    /// True for slots that hold a cached value
+    mutable std::array<bool, kCount> mCached{};
+    /// AbstractCV::enumTag() of each slot, so enum reads check the type as
+    /// the config does
+    mutable std::array<const void*, kCount> mTags{};
+};
+
+/**
+   Arena that holds whole ConfigTemplate objects and all of their values.
+
+   Configs made here are placed, together with every config value, key and
+   help string they allocate, in the arena's monotonic buffer.  release()
+   destroys them all and returns the memory in one shot, which makes building
+   and dropping many short lived configs cheap.
+*/
+class ConfigArena {
+    /// Node in the list of configs to destroy on release()
+    struct Entry {
+        void (*destroy)(void*);
+        void* obj;
+        Entry* next;
+    };
+
+    std::pmr::monotonic_buffer_resource mResource;
+    Entry* mEntries = nullptr;
+
+public:
+    /// Constructor
+    /// @param[in] initialSize Number of bytes to reserve up front
+    explicit ConfigArena(std::size_t initialSize = 4096)
+        : mResource(initialSize)
+    {
+    }
+
+    ConfigArena(const ConfigArena&) = delete;
+    ConfigArena& operator=(const ConfigArena&) = delete;
+
+    ~ConfigArena() { release(); }
+
+    /// Build a config in the arena
+    /// The config is valid until release() is called.
+    /// @param[in] overrides List of key/value pairs for specific config parms
+    template <typename TConfigEnum>
+    ConfigTemplate<TConfigEnum>* make(const ConfigOverrides& overrides)
+    {
+        using Config = ConfigTemplate<TConfigEnum>;
+        void* mem = mResource.allocate(sizeof(Config), alignof(Config));
+        Config* cfg = new (mem) Config(overrides, &mResource);
+        void* node = mResource.allocate(sizeof(Entry), alignof(Entry));
+        mEntries = new (node) Entry{ [](void* p) { static_cast<Config*>(p)->~Config(); }, cfg, mEntries };
+        return cfg;
+    }
+
+    /// Build a config in the arena, indexing the overrides in the arena too
+    template <typename TConfigEnum>
+    ConfigTemplate<TConfigEnum>* make(const std::map<std::string, std::string>& overrides)
+    {
+        return make<TConfigEnum>(ConfigOverrides(overrides, &mResource));
+    }
+
+    /// Build a config in the arena from brace-initialized pairs, e.g. {{"KEY", "value"}}
+    template <typename TConfigEnum>
+    ConfigTemplate<TConfigEnum>* make(std::initializer_list<std::pair<std::string_view, std::string_view>> overrides)
+    {
+        return make<TConfigEnum>(ConfigOverrides(overrides, &mResource));
+    }
+
+    /// Destroy every config made in the arena and free all of its memory
+    void release()
+    {
+        for (Entry* e = mEntries; e != nullptr; e = e->next) {
+            e->destroy(e->obj);
+        }
+        mEntries = nullptr;
+        mResource.release();
+    }
+
+    /// Return the memory resource backing the arena
+    std::pmr::memory_resource* resource() { return &mResource; }
 };
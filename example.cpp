@@ -1,6 +1,18 @@
+#include <fstream>
 #include <iostream>
+#include <future>
+#include <thread>
 #include <map>
 #include "cfg_template.hpp"
+#include "cfg_snapshot.hpp"
+#include "cfg_layered.hpp"
+#include "cfg_scoped.hpp"
+#include "cfg_overlay.hpp"
+#include "cfg_mmap.hpp"
+#include "cfg_loader.hpp"
+#include "cfg_shm.hpp"
+#include "cfg_replication.hpp"
+#include "cfg_export.hpp"
 
 
 enum class DatabaseConfigParm : int8_t;
@@ -18,24 +30,64 @@ enum class DatabaseConfigParm : int8_t
     STRIDESIZE,
     SHARED_FS_TYPE,
     CACHE_MEM_SZ,
+    COUNT
 };
 
+/// Shared file system types accepted by SHARED_FS
+enum class FsType : uint8_t
+{
+    Alluxio,
+    Hdfs,
+    S3,
+    Local
+};
+
+template <>
+struct ConfigEnumNames<FsType> {
+    static constexpr std::pair<std::string_view, FsType> names[] = {
+        { "alluxio", FsType::Alluxio }, { "hdfs", FsType::Hdfs }, { "s3", FsType::S3 }, { "local", FsType::Local } };
+};
+
+/// CACHE_MEM_SZ is set at runtime, so keep it off the lines other parms use
 template <>
-ConfigTemplate<DatabaseConfigParm>::ConfigTemplate(std::map<std::string, std::string> overrides)
-    : mFactory(overrides)
-    , mParms{ { DatabaseConfigParm::MAX_ROWS_PER_ROWGROUP, mFactory.Make_IntReadOnlyCV<int>("MAX_ROWS_PER_ROWGROUP", 10000, "Maximum number of rows per row group.") },
-        { DatabaseConfigParm::STRIDESIZE, mFactory.Make_IntReadOnlyCV<int16_t>("STRIDE_SIZE", 512, "Maximum stride size of a table") },
-        { DatabaseConfigParm::SHARED_FS_TYPE, mFactory.Make_StrReadOnlyCV("SHARED_FS", "alluxio", "The file system type") },
-        { DatabaseConfigParm::CACHE_MEM_SZ, mFactory.Make_IntUpdatableCV<int64_t>("CACHE_MEM_SZ", 0, "Memory size of cache") } }
+struct ConfigPadUpdatable<DatabaseConfigParm> : std::true_type {
+};
+
+template <>
+ConfigTemplate<DatabaseConfigParm>::ConfigTemplate(CVFactory&& factory)
+    : mResource(factory.resource())
+    , mParms{ { DatabaseConfigParm::MAX_ROWS_PER_ROWGROUP, factory.Make_IntReadOnlyCV<int>("MAX_ROWS_PER_ROWGROUP", 10000, "Maximum number of rows per row group.", intCheck<AtLeast<1>>()) },
+        { DatabaseConfigParm::STRIDESIZE, factory.Make_IntReadOnlyCV<int16_t>("STRIDE_SIZE", 512, "Maximum stride size of a table", intCheck<InRange<1, 4096>>()) },
+        { DatabaseConfigParm::SHARED_FS_TYPE, factory.Make_EnumReadOnlyCV("SHARED_FS", FsType::Alluxio, "The file system type") },
+        { DatabaseConfigParm::CACHE_MEM_SZ, factory.Make_IntUpdatableCV<int64_t>("CACHE_MEM_SZ", 0, "Memory size of cache", intCheck<AtLeast<0>>(), IntUnit::Size) } }
 {
 }
 
+template <>
+struct ConfigConstraints<DatabaseConfigParm> {
+    static constexpr ConfigConstraint<DatabaseConfigParm> list[] = {
+        { "STRIDE_SIZE must not exceed MAX_ROWS_PER_ROWGROUP",
+          [](const PendingConfig<DatabaseConfigParm>& cfg) {
+              return cfg.asInt(DatabaseConfigParm::STRIDESIZE) <= cfg.asInt(DatabaseConfigParm::MAX_ROWS_PER_ROWGROUP);
+          } },
+        { "CACHE_MEM_SZ must be a multiple of STRIDE_SIZE",
+          [](const PendingConfig<DatabaseConfigParm>& cfg) {
+              return cfg.asInt(DatabaseConfigParm::CACHE_MEM_SZ) % cfg.asInt(DatabaseConfigParm::STRIDESIZE) == 0;
+          } },
+    };
+};
+
+template <> struct ConfigParmTraits<DatabaseConfigParm, DatabaseConfigParm::MAX_ROWS_PER_ROWGROUP> { using CVType = IntReadOnlyCV<int>; };
+template <> struct ConfigParmTraits<DatabaseConfigParm, DatabaseConfigParm::STRIDESIZE> { using CVType = IntReadOnlyCV<int16_t>; };
+template <> struct ConfigParmTraits<DatabaseConfigParm, DatabaseConfigParm::SHARED_FS_TYPE> { using CVType = EnumReadOnlyCV<FsType>; };
+template <> struct ConfigParmTraits<DatabaseConfigParm, DatabaseConfigParm::CACHE_MEM_SZ> { using CVType = IntUpdatableCV<int64_t>; };
+
 using DatabaseConfig = ConfigTemplate<DatabaseConfigParm>;
 
 /**
    List of cluster config parameters.
 
-   Each parameter needs to be added to the ConfigTemplate for this enum in
+   Each parameter needs to be added to the ConfigRegistry for this enum in
    order to provide a default value and help text.
 */
 enum class ClusterConfigParm : int8_t
@@ -44,17 +96,24 @@ enum class ClusterConfigParm : int8_t
     ZK_TIMEOUT,
     QUORUM_WRITE,
     INSERT_FLUSH,
+    LOG_LEVEL,
+    TRACE_QUERIES,
+    HEARTBEAT_MS,
+    COUNT
 };
 
 template <>
-ConfigTemplate<ClusterConfigParm>::ConfigTemplate(std::map<std::string, std::string> overrides)
-    : mFactory(overrides)
-    , mParms{ { ClusterConfigParm::NUM_NODES, mFactory.Make_IntReadOnlyCV<int8_t>("NUM_NODES", 3, "Number of nodes in the cluster.") },
-        { ClusterConfigParm::ZK_TIMEOUT, mFactory.Make_IntReadOnlyCV<int64_t>("ZK_TIMEOUT", 10000, "Zookeeper timeout in milliseconds") },
-        { ClusterConfigParm::QUORUM_WRITE, mFactory.Make_StrReadOnlyCV("QUORUM_WRITE", "true", "Is quorum write set") },
-        { ClusterConfigParm::INSERT_FLUSH, mFactory.Make_BoolReadOnlyCV("INSERT_FLUSH", true, "Does each insert flush?") } }
-{
-}
+struct ConfigRegistry<ClusterConfigParm> {
+    static constexpr ParmDef<ClusterConfigParm> parms[] = {
+        intParm<int8_t, InRange<1, 100>>(ClusterConfigParm::NUM_NODES, "NUM_NODES", 3, "Number of nodes in the cluster."),
+        intParm<int64_t, AtLeast<1>>(ClusterConfigParm::ZK_TIMEOUT, "ZK_TIMEOUT", 10000, "Zookeeper timeout in milliseconds", IntUnit::Duration),
+        boolParm(ClusterConfigParm::QUORUM_WRITE, "QUORUM_WRITE", true, "Is quorum write set"),
+        boolParm(ClusterConfigParm::INSERT_FLUSH, "INSERT_FLUSH", true, "Does each insert flush?"),
+        updatableStrParm(ClusterConfigParm::LOG_LEVEL, "LOG_LEVEL", "info", "Minimum level of log messages"),
+        updatableBoolParm(ClusterConfigParm::TRACE_QUERIES, "TRACE_QUERIES", false, "Log the plan of every query"),
+        updatableIntParm<int64_t, AtLeast<1>>(ClusterConfigParm::HEARTBEAT_MS, "HEARTBEAT_MS", 1000, "Interval between node heartbeats in milliseconds", IntUnit::Duration),
+    };
+};
 
 using ClusterConfig = ConfigTemplate<ClusterConfigParm>;
 
@@ -96,9 +155,203 @@ int main()
     auto v11 = clcfg.as_<bool>(ClusterConfigParm::INSERT_FLUSH);
     std::cout << "Insert flush = " << std::boolalpha << v11 << " (" << sizeof(v11) << ")\n";
 
+    std::string_view logLevel = clcfg.get<ClusterConfigParm::LOG_LEVEL>();
+    clcfg.set(ClusterConfigParm::TRACE_QUERIES, "on");
+    clcfg.set(ClusterConfigParm::LOG_LEVEL, "debug");
+    std::cout << "Trace queries = " << clcfg.get<ClusterConfigParm::TRACE_QUERIES>()
+              << ", log level = " << clcfg.get<ClusterConfigParm::LOG_LEVEL>() << " (was " << logLevel << ")\n";
+    std::cout << "Set trace queries to maybe: " << setErrorStr(clcfg.trySet(ClusterConfigParm::TRACE_QUERIES, "maybe")) << "\n";
+
     auto v12 = clcfg.as_<uint64_t>(ClusterConfigParm::NUM_NODES);
     std::cout << "Num nodes = " << std::to_string(v12) << " (" << sizeof(v12) << ")\n";
 
     auto v13 = dbcfg.as_<uint8_t>(DatabaseConfigParm::CACHE_MEM_SZ);
     std::cout << "Cache mem size = " << std::to_string(v13) << " (" << sizeof(v13) << ") \n";
+
+    int64_t v14 = 0;
+    bool found = dbcfg.tryAs_(DatabaseConfigParm::COUNT, v14);
+    std::cout << "Unknown parm found = " << std::boolalpha << found << "\n";
+
+    int16_t v15 = dbcfg.get<DatabaseConfigParm::STRIDESIZE>();
+    std::cout << "Stridesize = " << v15 << " (" << sizeof(v15) << ")\n";
+
+    switch (dbcfg.get<DatabaseConfigParm::SHARED_FS_TYPE>()) {
+    case FsType::Alluxio: std::cout << "Shared FS is Alluxio\n"; break;
+    case FsType::Hdfs: std::cout << "Shared FS is HDFS\n"; break;
+    case FsType::S3: std::cout << "Shared FS is S3\n"; break;
+    case FsType::Local: std::cout << "Shared FS is local\n"; break;
+    }
+
+    try {
+        DatabaseConfig badFs(std::map<std::string, std::string>{ {"SHARED_FS", "nfs"} });
+    } catch (const std::invalid_argument& e) {
+        std::cout << "Rejected: " << e.what() << "\n";
+    }
+
+    CVStrBuf scratch;
+    std::cout << "Shared FS Type = " << dbcfg.asStrView(DatabaseConfigParm::SHARED_FS_TYPE, scratch) << "\n";
+    std::cout << "Cache mem size = " << dbcfg.asStrView(DatabaseConfigParm::CACHE_MEM_SZ, scratch) << "\n";
+
+    SnapshotConfig<DatabaseConfigParm> dbsnap(dbOverrides);
+    auto before = dbsnap.acquire();
+    dbsnap.publish({ { DatabaseConfigParm::CACHE_MEM_SZ, "8192" } });
+    auto after = dbsnap.acquire();
+    std::cout << "Snapshot cache mem size = " << before->as_<int64_t>(DatabaseConfigParm::CACHE_MEM_SZ)
+              << " -> " << after->as_<int64_t>(DatabaseConfigParm::CACHE_MEM_SZ) << "\n";
+
+    thread_local CachedConfigView<DatabaseConfigParm> dbview(dbcfg);
+    dbcfg.set(DatabaseConfigParm::CACHE_MEM_SZ, "2048");
+    std::cout << "Cached cache mem size = " << dbview.as_<int64_t>(DatabaseConfigParm::CACHE_MEM_SZ) << "\n";
+
+    dbcfg.set("CACHE_MEM_SZ", "1024");
+    std::cout << "Cache mem size by key = " << dbcfg.as_<int64_t>("CACHE_MEM_SZ") << "\n";
+
+    ConfigArena arena;
+    auto sessionCfg = arena.make<DatabaseConfigParm>({ {"STRIDE_SIZE", "256"} });
+    std::cout << "Arena stridesize = " << sessionCfg->as_<int>(DatabaseConfigParm::STRIDESIZE) << "\n";
+    std::cout << "ZK Timeout = " << clcfg.get<ClusterConfigParm::ZK_TIMEOUT>() << "\n";
+
+    auto dbBase = std::make_shared<const DatabaseConfig>(dbOverrides);
+    LayeredConfig<DatabaseConfigParm> session(dbBase, { {"STRIDE_SIZE", "128"} });
+    session.set(DatabaseConfigParm::CACHE_MEM_SZ, "512");
+    std::cout << "Session stridesize = " << session.as_<int>(DatabaseConfigParm::STRIDESIZE)
+              << ", cache mem size = " << session.as_<int64_t>(DatabaseConfigParm::CACHE_MEM_SZ)
+              << " (base " << dbBase->as_<int64_t>(DatabaseConfigParm::CACHE_MEM_SZ) << ")\n";
+
+    ScopedConfig<DatabaseConfigParm> globalScope(dbBase);
+    ScopedConfig<DatabaseConfigParm> nodeScope(globalScope, { {"SHARED_FS", "hdfs"} });
+    ScopedConfig<DatabaseConfigParm> sessionScope(nodeScope, { {"STRIDE_SIZE", "64"} });
+    globalScope.overrideValue(DatabaseConfigParm::MAX_ROWS_PER_ROWGROUP, "2048");
+    std::cout << "Session scope: rows = " << sessionScope.as_<int>(DatabaseConfigParm::MAX_ROWS_PER_ROWGROUP)
+              << ", fs = " << sessionScope.as_<std::string>(DatabaseConfigParm::SHARED_FS_TYPE)
+              << ", stridesize = " << sessionScope.as_<int>(DatabaseConfigParm::STRIDESIZE) << "\n";
+
+    {
+        ConfigOverlay<DatabaseConfigParm> query(dbcfg);
+        query.overrideValue("MAX_ROWS_PER_ROWGROUP", "4096");
+        query.overrideValue(DatabaseConfigParm::SHARED_FS_TYPE, "local");
+        std::cout << "Query overlay: rows = " << query.as_<int>(DatabaseConfigParm::MAX_ROWS_PER_ROWGROUP)
+                  << " (base " << dbcfg.as_<int>(DatabaseConfigParm::MAX_ROWS_PER_ROWGROUP) << ")"
+                  << ", fs local = " << (query.get<DatabaseConfigParm::SHARED_FS_TYPE>() == FsType::Local)
+                  << ", stridesize = " << query.as_<int>(DatabaseConfigParm::STRIDESIZE) << "\n";
+        try {
+            query.overrideValue(DatabaseConfigParm::MAX_ROWS_PER_ROWGROUP, "256");
+        } catch (const std::invalid_argument& e) {
+            std::cout << "Query overlay rejected: " << e.what() << "\n";
+        }
+    }
+
+    std::promise<int64_t> resized;
+    auto subId = dbcfg.subscribe(DatabaseConfigParm::CACHE_MEM_SZ, [&](const std::vector<DatabaseConfigParm>&) {
+        resized.set_value(dbcfg.as_<int64_t>(DatabaseConfigParm::CACHE_MEM_SZ));
+    });
+    dbcfg.set(DatabaseConfigParm::CACHE_MEM_SZ, "65536");
+    std::cout << "Cache resized to " << resized.get_future().get() << "\n";
+    dbcfg.unsubscribe(subId);
+
+    auto errs = dbcfg.setMany({ { DatabaseConfigParm::CACHE_MEM_SZ, "1" }, { DatabaseConfigParm::STRIDESIZE, "1024" } });
+    std::cout << "Batch update: " << setErrorStr(errs[0]) << ", " << setErrorStr(errs[1])
+              << "; cache mem size = " << dbcfg.as_<int64_t>(DatabaseConfigParm::CACHE_MEM_SZ) << "\n";
+
+    SetError err = dbcfg.trySet(DatabaseConfigParm::CACHE_MEM_SZ, "4GB");
+    std::cout << "Set cache mem size to 4GB: " << setErrorStr(err)
+              << " (" << dbcfg.as_<int64_t>(DatabaseConfigParm::CACHE_MEM_SZ) << ")\n";
+    err = dbcfg.trySet(DatabaseConfigParm::CACHE_MEM_SZ, "-1");
+    std::cout << "Set cache mem size to -1: " << setErrorStr(err) << "\n";
+    err = dbcfg.trySet(DatabaseConfigParm::CACHE_MEM_SZ, "1000");
+    std::cout << "Set cache mem size to 1000: " << setErrorStr(err)
+              << " (" << dbcfg.as_<int64_t>(DatabaseConfigParm::CACHE_MEM_SZ) << ")\n";
+    try {
+        std::map<std::string, std::string> smallRowGroups = { {"MAX_ROWS_PER_ROWGROUP", "256"} };
+        DatabaseConfig rejected(smallRowGroups);
+    } catch (const std::invalid_argument& e) {
+        std::cout << "Rejected: " << e.what() << "\n";
+    }
+
+    writeConfigSnapshot(dbcfg, "/tmp/dbcfg.snap");
+    MappedConfig<DatabaseConfigParm> mapped("/tmp/dbcfg.snap", configSchema(dbcfg));
+    std::cout << "Mapped snapshot: " << mapped.key(DatabaseConfigParm::CACHE_MEM_SZ) << " = "
+              << mapped.as_<int64_t>(DatabaseConfigParm::CACHE_MEM_SZ)
+              << ", fs = " << mapped.as_<std::string_view>(DatabaseConfigParm::SHARED_FS_TYPE) << "\n";
+
+    std::ofstream("/tmp/dbcfg.conf") << "# database config\nSHARED_FS = s3\nCACHE_MEM_SZ = 1MB\n";
+    ConfigSource fileSrc = ConfigSource::fromFile("/tmp/dbcfg.conf");
+    DatabaseConfig filecfg(fileSrc.overrides());
+    ConfigFileWatcher<DatabaseConfigParm> watcher(filecfg, "/tmp/dbcfg.conf");
+    // SHARED_FS is read-only, so only the cache size change is applied
+    std::ofstream("/tmp/dbcfg.conf") << "# database config\nSHARED_FS = hdfs\nCACHE_MEM_SZ = 2MB\n";
+    for (auto& change : watcher.poll(1000)) {
+        std::cout << "Reloaded " << change.first << ": " << setErrorStr(change.second)
+                  << " (" << filecfg.as_<int64_t>(DatabaseConfigParm::CACHE_MEM_SZ) << ")\n";
+    }
+
+    auto built = std::async(std::launch::async, [] {
+        std::map<std::string, std::string> overrides = { {"NUM_NODES", "7"} };
+        return ClusterConfig(overrides);
+    });
+    ClusterConfig handedOff(built.get());
+    std::cout << "Built in background: nodes = " << handedOff.as_<int>(ClusterConfigParm::NUM_NODES) << "\n";
+
+    {
+        // Normally the reader is another process on the node
+        SharedConfigPublisher<ClusterConfigParm> publisher("/example-cluster-config", handedOff);
+        SharedConfig<ClusterConfigParm> shared("/example-cluster-config");
+        publisher.setMany({ {ClusterConfigParm::HEARTBEAT_MS, "3000"}, {ClusterConfigParm::LOG_LEVEL, "warn"} });
+        std::cout << "Shared config: " << shared.key(ClusterConfigParm::HEARTBEAT_MS) << " = "
+                  << shared.as_<int64_t>(ClusterConfigParm::HEARTBEAT_MS)
+                  << ", nodes = " << shared.as_<int>(ClusterConfigParm::NUM_NODES)
+                  << ", log level = " << shared.as_<std::string>(ClusterConfigParm::LOG_LEVEL)
+                  << ", version = " << shared.version() << "\n";
+    }
+
+    {
+        // The sender would normally write to each follower's connection
+        ClusterConfig follower(clusterOverrides);
+        ConfigDeltaApplier<ClusterConfigParm> applier(follower);
+        std::string lastDelta;
+        ConfigReplicator<ClusterConfigParm> replicator(handedOff, [&](std::string_view delta) {
+            lastDelta = delta;
+            applier.apply(delta);
+        });
+        std::cout << "Follower snapshot: " << deltaStatusStr(applier.apply(replicator.snapshot())) << "\n";
+        for (int interval : { 4000, 4500, 5000 }) {
+            handedOff.set(ClusterConfigParm::HEARTBEAT_MS, std::to_string(interval));
+        }
+        for (int i = 0; i < 1000 && follower.as_<int64_t>(ClusterConfigParm::HEARTBEAT_MS) != 5000; ++i) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        std::cout << "Follower HEARTBEAT_MS = " << follower.as_<int64_t>(ClusterConfigParm::HEARTBEAT_MS)
+                  << ", log level = " << follower.as_<std::string>(ClusterConfigParm::LOG_LEVEL)
+                  << ", resend: " << deltaStatusStr(applier.apply(lastDelta)) << "\n";
+    }
+
+    {
+        ConfigExport<ClusterConfigParm> scrape(handedOff);
+        scrape.capture();
+        for (auto& parm : scrape) {
+            std::cout << "Export: " << parm.key << " (" << cvKindName(parm.kind) << ")\n";
+        }
+        char text[2048];
+        std::size_t len = scrape.renderPrometheus(text, sizeof(text));
+        std::cout.write(text, std::min(len, sizeof(text)));
+        len = scrape.renderJson(text, sizeof(text));
+        std::cout.write(text, std::min(len, sizeof(text))) << "\n";
+    }
+
+#if CFG_TEMPLATE_STATS
+    dbcfg.enableStats();
+    for (int i = 0; i < 3; ++i) {
+        dbcfg.as_<int>(DatabaseConfigParm::MAX_ROWS_PER_ROWGROUP);
+    }
+    dbcfg.trySet(DatabaseConfigParm::CACHE_MEM_SZ, "1GB");
+    dbcfg.trySet(DatabaseConfigParm::SHARED_FS_TYPE, "hdfs");
+    dbcfg.asStrView(DatabaseConfigParm::CACHE_MEM_SZ, scratch);
+    std::cout << "Access stats:\n" << dbcfg.stats().str();
+#endif
+
+    ConfigSource jsonSrc(R"({ "NUM_NODES": 5, "QUORUM_WRITE": "false" })");
+    ClusterConfig jsoncfg(jsonSrc.overrides());
+    std::cout << "JSON config: nodes = " << jsoncfg.as_<int>(ClusterConfigParm::NUM_NODES)
+              << ", quorum write = " << jsoncfg.as_<bool>(ClusterConfigParm::QUORUM_WRITE) << "\n";
+    arena.release();
 }
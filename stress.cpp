@@ -0,0 +1,303 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "cfg_template.hpp"
+#include "cfg_snapshot.hpp"
+
+/*
+   Concurrency stress test for config reads racing with set().
+
+   Reader threads hammer one config while writer threads update it, and every
+   value a reader sees is checked:
+
+   - SEQ is set to 1, 2, 3, ... by a single writer.  A reader must never see
+     it go backwards, or get ahead of the value the writer has started to set.
+   - PATTERN is only ever set to values whose high and low 32 bits are equal,
+     so a torn read shows up as a mismatch.
+   - PAIR_A and PAIR_B are only changed together, by setMany() or a snapshot
+     publish.  A reader that reads both within one even config version, or
+     from one snapshot, must see them equal.
+
+   Each read mode runs for a fixed time at 1, 2, 4, ... readers, up to the
+   maximum, and read throughput is reported as CSV:
+
+       mode,readers,reads,ns_per_read,scaling
+
+   A read is one round of the checks above: SEQ, PATTERN and both PAIR
+   values.  ns_per_read is the time one reader spends per read, and scaling
+   is total throughput relative to one reader.  Reader counts above the core
+   count are oversubscribed and won't scale.  The exit status is non-zero if
+   any check failed.
+
+   Usage: stress [max_readers [ms_per_step]]
+*/
+
+enum class StressParm : int8_t { SEQ, PATTERN, PAIR_A, PAIR_B, COUNT };
+enum class PaddedStressParm : int8_t { SEQ, PATTERN, PAIR_A, PAIR_B, COUNT };
+
+template <typename TConfigEnum>
+struct StressRegistry {
+    static constexpr ParmDef<TConfigEnum> parms[] = {
+        updatableIntParm<int64_t>(TConfigEnum::SEQ, "SEQ", 0, "Set to 1, 2, 3, ... by one writer"),
+        updatableIntParm<int64_t>(TConfigEnum::PATTERN, "PATTERN", 0, "High and low halves always match"),
+        updatableIntParm<int64_t>(TConfigEnum::PAIR_A, "PAIR_A", 0, "Always set together with PAIR_B"),
+        updatableIntParm<int64_t>(TConfigEnum::PAIR_B, "PAIR_B", 0, "Always set together with PAIR_A"),
+    };
+};
+
+template <> struct ConfigRegistry<StressParm> : StressRegistry<StressParm> {};
+template <> struct ConfigRegistry<PaddedStressParm> : StressRegistry<PaddedStressParm> {};
+
+/// Exercise the padded layout too, where updatable values live in a HotValueBlock
+template <>
+struct ConfigPadUpdatable<PaddedStressParm> : std::true_type {
+};
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+/// Failed checks, across all modes
+std::atomic<uint64_t> gFailures{0};
+std::mutex gFailureMutex;
+
+void fail(const char* mode, const std::string& what)
+{
+    // Only the first few are worth reading
+    if (gFailures.fetch_add(1) < 10) {
+        std::lock_guard<std::mutex> lock(gFailureMutex);
+        std::fprintf(stderr, "FAIL %s: %s\n", mode, what.c_str());
+    }
+}
+
+/// Value of PATTERN for step n
+int64_t pattern(int64_t n)
+{
+    n &= 0x7fffffff;
+    return (n << 32) | n;
+}
+
+/// Checks the SEQ and PATTERN values one reader sees
+struct SeqChecker {
+    const char* mode;
+    /// Value of SEQ the writer has started to set
+    const std::atomic<int64_t>& started;
+    int64_t last = 0;
+
+    void seq(int64_t v) {
+        if (v < last) {
+            fail(mode, "SEQ went backwards from " + std::to_string(last) + " to " + std::to_string(v));
+        } else if (v > started.load(std::memory_order_acquire)) {
+            fail(mode, "SEQ " + std::to_string(v) + " was read before it was set");
+        }
+        last = v;
+    }
+
+    void pattern(int64_t v) {
+        if ((v >> 32) != (v & 0xffffffff)) {
+            fail(mode, "torn PATTERN " + std::to_string(v));
+        }
+    }
+
+    void pair(int64_t a, int64_t b) {
+        if (a != b) {
+            fail(mode, "PAIR_A " + std::to_string(a) + " != PAIR_B " + std::to_string(b));
+        }
+    }
+};
+
+/// Runs readers and writers for one step and collects the read count
+struct Step {
+    std::atomic<bool> go{false};
+    std::atomic<bool> stop{false};
+    std::atomic<uint64_t> reads{0};
+    std::atomic<int64_t> started{0};
+
+    /// Run read(checker) in a loop on each reader thread and each writer's
+    /// write(n) for n = 1, 2, ... on its own thread, for the length of the step
+    template <typename ReadFn, typename... WriteFns>
+    Clock::duration run(const char* mode, unsigned readers, std::chrono::milliseconds length, ReadFn read,
+                        WriteFns... writes) {
+        std::vector<std::thread> threads;
+        for (unsigned r = 0; r < readers; ++r) {
+            threads.emplace_back([&, read] {
+                SeqChecker checker{ mode, started };
+                uint64_t n = 0;
+                while (!go.load(std::memory_order_acquire)) {
+                    std::this_thread::yield();
+                }
+                while (!stop.load(std::memory_order_relaxed)) {
+                    for (int i = 0; i < 64; ++i) {
+                        read(checker);
+                    }
+                    n += 64;
+                }
+                reads.fetch_add(n);
+            });
+        }
+        (threads.emplace_back([&, write = writes] {
+            while (!go.load(std::memory_order_acquire)) {
+                std::this_thread::yield();
+            }
+            for (int64_t n = 1; !stop.load(std::memory_order_relaxed); ++n) {
+                write(n);
+            }
+        }), ...);
+
+        auto start = Clock::now();
+        go.store(true, std::memory_order_release);
+        std::this_thread::sleep_for(length);
+        stop.store(true);
+        auto elapsed = Clock::now() - start;
+        for (auto& t : threads) {
+            t.join();
+        }
+        return elapsed;
+    }
+};
+
+/// Print one row and return the throughput, in reads per second
+double report(const char* mode, unsigned readers, uint64_t reads, Clock::duration elapsed, double base)
+{
+    double ns = std::chrono::duration<double, std::nano>(elapsed).count();
+    double rate = reads / ns * 1e9;
+    std::printf("%s,%u,%llu,%.3f,%.2f\n", mode, readers, static_cast<unsigned long long>(reads),
+                ns * readers / std::max<uint64_t>(reads, 1), base > 0 ? rate / base : 1.0);
+    std::fflush(stdout);
+    return rate;
+}
+
+/// Readers call as_<int64_t>() (or get<>()) on a config that writers set()
+/// and setMany() in place
+template <typename TConfigEnum, bool Typed>
+double stressInPlace(const char* mode, unsigned readers, std::chrono::milliseconds length, double base)
+{
+    ConfigTemplate<TConfigEnum> cfg(std::map<std::string, std::string>{});
+    Step step;
+    auto elapsed = step.run(mode, readers, length,
+        [&cfg](SeqChecker& check) {
+            if constexpr (Typed) {
+                check.seq(cfg.template get<TConfigEnum::SEQ>());
+                check.pattern(cfg.template get<TConfigEnum::PATTERN>());
+            } else {
+                check.seq(cfg.template as_<int64_t>(TConfigEnum::SEQ));
+                check.pattern(cfg.template as_<int64_t>(TConfigEnum::PATTERN));
+            }
+            uint64_t version = cfg.version();
+            int64_t a = cfg.template as_<int64_t>(TConfigEnum::PAIR_A);
+            int64_t b = cfg.template as_<int64_t>(TConfigEnum::PAIR_B);
+            if ((version & 1) == 0 && cfg.version() == version) {
+                check.pair(a, b);
+            }
+        },
+        [&](int64_t n) {
+            step.started.store(n, std::memory_order_release);
+            cfg.set(TConfigEnum::SEQ, std::to_string(n));
+        },
+        [&cfg](int64_t n) {
+            cfg.set(TConfigEnum::PATTERN, std::to_string(pattern(n)));
+            std::string v = std::to_string(n);
+            cfg.setMany({ { TConfigEnum::PAIR_A, v }, { TConfigEnum::PAIR_B, v } });
+        });
+    return report(mode, readers, step.reads.load(), elapsed, base);
+}
+
+/// Readers go through a thread-local CachedConfigView
+double stressCached(const char* mode, unsigned readers, std::chrono::milliseconds length, double base)
+{
+    ConfigTemplate<StressParm> cfg(std::map<std::string, std::string>{});
+    Step step;
+    auto elapsed = step.run(mode, readers, length,
+        [&cfg](SeqChecker& check) {
+            // One view per reader thread; a step's threads never outlive its config
+            thread_local CachedConfigView<StressParm> view(cfg);
+            check.seq(view.as_<int64_t>(StressParm::SEQ));
+            check.pattern(view.as_<int64_t>(StressParm::PATTERN));
+            uint64_t version = cfg.version();
+            int64_t a = view.as_<int64_t>(StressParm::PAIR_A);
+            int64_t b = view.as_<int64_t>(StressParm::PAIR_B);
+            if ((version & 1) == 0 && cfg.version() == version) {
+                check.pair(a, b);
+            }
+        },
+        [&](int64_t n) {
+            step.started.store(n, std::memory_order_release);
+            cfg.set(StressParm::SEQ, std::to_string(n));
+        },
+        [&cfg](int64_t n) {
+            cfg.set(StressParm::PATTERN, std::to_string(pattern(n)));
+            std::string v = std::to_string(n);
+            cfg.setMany({ { StressParm::PAIR_A, v }, { StressParm::PAIR_B, v } });
+        });
+    return report(mode, readers, step.reads.load(), elapsed, base);
+}
+
+/// Readers pin SnapshotConfig versions while a writer publishes new ones
+double stressSnapshot(const char* mode, unsigned readers, std::chrono::milliseconds length, double base)
+{
+    SnapshotConfig<StressParm> snaps({});
+    Step step;
+    auto elapsed = step.run(mode, readers, length,
+        [&snaps](SeqChecker& check) {
+            auto snap = snaps.acquire();
+            check.seq(snap->as_<int64_t>(StressParm::SEQ));
+            check.pattern(snap->as_<int64_t>(StressParm::PATTERN));
+            check.pair(snap->as_<int64_t>(StressParm::PAIR_A), snap->as_<int64_t>(StressParm::PAIR_B));
+        },
+        [&](int64_t n) {
+            step.started.store(n, std::memory_order_release);
+            std::string v = std::to_string(n);
+            snaps.publish({ { StressParm::SEQ, v }, { StressParm::PATTERN, std::to_string(pattern(n)) },
+                            { StressParm::PAIR_A, v }, { StressParm::PAIR_B, v } });
+        });
+    return report(mode, readers, step.reads.load(), elapsed, base);
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    unsigned maxReaders = argc > 1 ? static_cast<unsigned>(std::atoi(argv[1])) : 128;
+    std::chrono::milliseconds length(argc > 2 ? std::atoi(argv[2]) : 200);
+    if (maxReaders == 0 || length.count() <= 0) {
+        std::fprintf(stderr, "Usage: %s [max_readers [ms_per_step]]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+    std::fprintf(stderr, "%u cores\n", std::thread::hardware_concurrency());
+    std::printf("mode,readers,reads,ns_per_read,scaling\n");
+
+    struct Mode {
+        const char* name;
+        double (*run)(const char*, unsigned, std::chrono::milliseconds, double);
+    };
+    const Mode modes[] = {
+        { "as", stressInPlace<StressParm, false> },
+        { "get", stressInPlace<StressParm, true> },
+        { "as-padded", stressInPlace<PaddedStressParm, false> },
+        { "cached", stressCached },
+        { "snapshot", stressSnapshot },
+    };
+    for (const Mode& mode : modes) {
+        double base = 0;
+        for (unsigned readers = 1; readers <= maxReaders; readers *= 2) {
+            double rate = mode.run(mode.name, readers, length, base);
+            if (readers == 1) {
+                base = rate;
+            }
+        }
+    }
+
+    uint64_t failures = gFailures.load();
+    if (failures != 0) {
+        std::fprintf(stderr, "%llu failed checks\n", static_cast<unsigned long long>(failures));
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,239 @@
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <future>
+#include <map>
+#include <string>
+#include <vector>
+#include <unistd.h>
+#include "cfg_export.hpp"
+#include "cfg_shm.hpp"
+#include "cfg_template.hpp"
+
+/*
+   Regression checks for config behavior that example.cpp doesn't show.
+
+   Each check prints a FAIL line for every expectation it misses.  The exit
+   status is non-zero if any check failed.
+
+   Usage: tests
+*/
+
+enum class TestParm : int8_t { COUNT_LIMIT, LABEL, CACHE_SIZE, TIMEOUT, MODE, VERBOSE, COUNT };
+
+enum class TestMode : uint8_t { Fast, Safe };
+enum class OtherMode : uint8_t { Fast, Safe };
+
+template <>
+struct ConfigEnumNames<TestMode> {
+    static constexpr std::pair<std::string_view, TestMode> names[] = { { "fast", TestMode::Fast }, { "safe", TestMode::Safe } };
+};
+
+template <>
+struct ConfigRegistry<TestParm> {
+    static constexpr ParmDef<TestParm> parms[] = {
+        updatableIntParm<int64_t>(TestParm::COUNT_LIMIT, "COUNT_LIMIT", 10, "Plain count"),
+        updatableStrParm(TestParm::LABEL, "LABEL", "none", "Free text"),
+        updatableIntParm<int64_t>(TestParm::CACHE_SIZE, "CACHE_SIZE", 0, "Cache size in bytes", IntUnit::Size),
+        intParm<int64_t>(TestParm::TIMEOUT, "TIMEOUT", 1000, "Timeout in milliseconds", IntUnit::Duration),
+        enumParm(TestParm::MODE, "MODE", TestMode::Safe, "Write mode"),
+        updatableBoolParm(TestParm::VERBOSE, "VERBOSE", false, "Log every request"),
+    };
+};
+
+namespace {
+
+using TestConfig = ConfigTemplate<TestParm>;
+
+int gFailures = 0;
+
+void expect(bool ok, const char* check, const std::string& what)
+{
+    if (!ok) {
+        ++gFailures;
+        std::fprintf(stderr, "FAIL %s: %s\n", check, what.c_str());
+    }
+}
+
+/// Changes are still delivered when the notifier was first made by
+/// unsubscribe() rather than subscribe()
+void checkUnsubscribeFirst()
+{
+    const char* name = "unsubscribe-first";
+    TestConfig cfg(std::map<std::string, std::string>{});
+    cfg.unsubscribe(42);
+    try {
+        cfg.set(TestParm::COUNT_LIMIT, "11");
+    } catch (const std::exception& e) {
+        expect(false, name, std::string("set() threw ") + e.what());
+    }
+    std::promise<int64_t> seen;
+    cfg.subscribe(TestParm::COUNT_LIMIT, [&](const std::vector<TestParm>&) {
+        seen.set_value(cfg.as_<int64_t>(TestParm::COUNT_LIMIT));
+    });
+    cfg.set(TestParm::COUNT_LIMIT, "12");
+    auto future = seen.get_future();
+    bool delivered = future.wait_for(std::chrono::seconds(5)) == std::future_status::ready;
+    expect(delivered, name, "later set() was never delivered");
+    expect(!delivered || future.get() == 12, name, "delivered the wrong value");
+
+    bool rejected = false;
+    try {
+        cfg.setExecutor({});
+    } catch (const std::invalid_argument&) {
+        rejected = true;
+    }
+    expect(rejected, name, "setExecutor() accepted an empty executor");
+}
+
+/// Integer values accept only the unit suffixes of what they measure
+void checkUnitSuffixes()
+{
+    const char* name = "unit-suffixes";
+    int64_t out = 0;
+    expect(parseInt("1M", out, IntUnit::Size) == ParseError::None && out == (int64_t(1) << 20), name,
+           "1M is not a MiB");
+    expect(parseInt("10s", out, IntUnit::Size) == ParseError::BadSuffix, name, "size accepted a duration suffix");
+    expect(parseInt("2GB", out, IntUnit::Duration) == ParseError::BadSuffix, name, "duration accepted a size suffix");
+    expect(parseInt("5K", out) == ParseError::BadSuffix, name, "plain number accepted a suffix");
+
+    TestConfig cfg(std::map<std::string, std::string>{ { "TIMEOUT", "2s" } });
+    expect(cfg.as_<int64_t>(TestParm::TIMEOUT) == 2000, name, "duration override was not scaled");
+    expect(cfg.trySet(TestParm::CACHE_SIZE, "10s") == SetError::InvalidValue, name, "set accepted 10s for a size");
+    expect(cfg.trySet(TestParm::CACHE_SIZE, "1M") == SetError::None
+               && cfg.as_<int64_t>(TestParm::CACHE_SIZE) == (int64_t(1) << 20),
+           name, "set did not scale 1M");
+    expect(cfg.trySet(TestParm::COUNT_LIMIT, "1K") == SetError::InvalidValue, name, "set accepted 1K for a count");
+
+    bool rejected = false;
+    try {
+        TestConfig bad(std::map<std::string, std::string>{ { "TIMEOUT", "2GB" } });
+    } catch (const std::invalid_argument&) {
+        rejected = true;
+    }
+    expect(rejected, name, "override accepted 2GB for a duration");
+}
+
+/// A cached view checks the enum type of a read as the config does
+void checkCachedEnumType()
+{
+    const char* name = "cached-enum-type";
+    TestConfig cfg(std::map<std::string, std::string>{});
+    CachedConfigView<TestParm> view(cfg);
+    expect(view.as_<TestMode>(TestParm::MODE) == TestMode::Safe, name, "read the wrong enum value");
+
+    auto rejects = [&](auto read) {
+        try {
+            read();
+        } catch (const std::invalid_argument&) {
+            return true;
+        }
+        return false;
+    };
+    expect(rejects([&] { view.as_<OtherMode>(TestParm::MODE); }), name, "read an enum as another enum type");
+    expect(rejects([&] { view.as_<TestMode>(TestParm::COUNT_LIMIT); }), name, "read an integer as an enum");
+}
+
+/// Rebinding an updatable bool parses as strictly as setting it
+void checkStrictBoolRebind()
+{
+    const char* name = "strict-bool-rebind";
+    TestConfig cfg(std::map<std::string, std::string>{});
+    const AbstractCV& val = *cfg.find(TestParm::VERBOSE);
+    expect(val.rebind("ON", std::pmr::get_default_resource())->asBool(), name, "ON did not rebind to true");
+    expect(cfg.trySet(TestParm::VERBOSE, "yes") == SetError::InvalidValue, name, "set accepted yes");
+    bool rejected = false;
+    try {
+        val.rebind("yes", std::pmr::get_default_resource());
+    } catch (const std::invalid_argument&) {
+        rejected = true;
+    }
+    expect(rejected, name, "rebind accepted yes");
+}
+
+/// Exporting a moved-from config leaves out its empty slots
+void checkExportMovedFrom()
+{
+    const char* name = "export-moved-from";
+    TestConfig cfg(std::map<std::string, std::string>{});
+    ConfigExport<TestParm> live(cfg);
+    expect(live.end() - live.begin() == static_cast<std::ptrdiff_t>(std::size(ConfigRegistry<TestParm>::parms)), name,
+           "export is missing parms");
+
+    TestConfig moved(std::move(cfg));
+    ConfigExport<TestParm> empty(cfg);
+    expect(empty.begin() == empty.end(), name, "export of a moved-from config has views");
+    live.capture();
+    char buf[2048];
+    std::size_t len = live.renderJson(buf, sizeof(buf));
+    expect(len < sizeof(buf) && std::string_view(buf, len).find("\"COUNT_LIMIT\"") != std::string_view::npos, name,
+           "capture after the move lost the last values");
+}
+
+/// The shared segment rejects values that don't fit instead of overrunning
+/// an entry, and never has room for less than the longest integer
+void checkSharedCapacity()
+{
+    const char* name = "shared-capacity";
+    std::string shmName = "/cfg-tests-" + std::to_string(::getpid());
+    TestConfig cfg(std::map<std::string, std::string>{});
+
+    bool rejected = false;
+    try {
+        SharedConfigPublisher<TestParm> tiny(shmName, cfg, 8);
+    } catch (const std::invalid_argument&) {
+        rejected = true;
+    }
+    expect(rejected, name, "accepted a capacity below kMinStrCapacity");
+
+    SharedConfigPublisher<TestParm> publisher(shmName, cfg, SharedConfigPublisher<TestParm>::kMinStrCapacity);
+    std::vector<SetError> results = publisher.setMany({ { TestParm::COUNT_LIMIT, "-9223372036854775807" },
+                                                        { TestParm::LABEL, std::string(25, 'x') } });
+    expect(results == std::vector<SetError>{ SetError::BatchRejected, SetError::OutOfRange }, name,
+           "oversized string was not rejected");
+    expect(cfg.as_<int64_t>(TestParm::COUNT_LIMIT) == 10, name, "rejected batch was applied");
+
+    expect(publisher.trySet(TestParm::COUNT_LIMIT, "-9223372036854775807") == SetError::None, name,
+           "longest integer did not fit");
+    SharedConfig<TestParm> reader(shmName);
+    expect(reader.as_<std::string>(TestParm::COUNT_LIMIT) == "-9223372036854775807", name,
+           "published the wrong string form");
+}
+
+/// A reader whose schema differs from the publisher's rejects the segment
+void checkSharedSchema()
+{
+    const char* name = "shared-schema";
+    std::string shmName = "/cfg-tests-" + std::to_string(::getpid());
+    TestConfig cfg(std::map<std::string, std::string>{});
+    SharedConfigPublisher<TestParm> publisher(shmName, cfg);
+
+    SharedConfig<TestParm> reader(shmName);
+    expect(reader.as_<std::string>(TestParm::LABEL) == "none", name, "matching reader read the wrong value");
+    bool rejected = false;
+    try {
+        SharedConfig<TestParm> other(shmName, configSchema(cfg) + 1);
+    } catch (const std::runtime_error&) {
+        rejected = true;
+    }
+    expect(rejected, name, "reader with another schema was accepted");
+}
+
+} // namespace
+
+int main()
+{
+    checkUnsubscribeFirst();
+    checkUnitSuffixes();
+    checkCachedEnumType();
+    checkStrictBoolRebind();
+    checkExportMovedFrom();
+    checkSharedCapacity();
+    checkSharedSchema();
+    if (gFailures != 0) {
+        std::fprintf(stderr, "%d failed checks\n", gFailures);
+        return EXIT_FAILURE;
+    }
+    std::printf("all checks passed\n");
+    return EXIT_SUCCESS;
+}